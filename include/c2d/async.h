@@ -0,0 +1,94 @@
+/**
+ * @file async.h
+ * @brief Asynchronous loading of fonts and sprite sheets
+ */
+#pragma once
+#include "base.h"
+#include "font.h"
+#include "spritesheet.h"
+
+struct C2D_LoadJob_s;
+typedef struct C2D_LoadJob_s* C2D_LoadJob;
+
+/** @defgroup Async Asynchronous loading functions
+ *  @{
+ */
+
+typedef enum
+{
+	C2D_LoadPending, ///< The resource is still being loaded
+	C2D_LoadDone,    ///< The resource was loaded successfully
+	C2D_LoadFailed,  ///< The resource could not be loaded
+} C2D_LoadStatus;
+
+/** @brief Function called when an asynchronous load completes
+ *  @param[in] job Load job handle, whose status is either C2D_LoadDone or C2D_LoadFailed
+ *  @param[in] userData User data passed when starting the load
+ */
+typedef void (*C2D_LoadCallback)(C2D_LoadJob job, void* userData);
+
+/** @brief Load a font from a file on the worker thread
+ *  @param[in] filename Name of the font file (.bcfnt)
+ *  @param[in] callback Function to call once the font is loaded (optional)
+ *  @param[in] userData User data to pass to the callback
+ *  @returns Load job handle
+ *  @retval NULL Error, or C2D_LoadJobsFini is stopping the worker thread
+ *  @remark Reading the file happens on a worker thread, started the first time something is loaded
+ *          asynchronously. The font only becomes available to the calling thread through C2D_LoadJobPoll
+ *          or C2D_LoadJobsUpdate, which finish preparing it for the GPU and run the callback.
+ */
+C2D_LoadJob C2D_FontLoadAsync(const char* filename, C2D_LoadCallback callback, void* userData);
+
+/** @brief Load a sprite sheet from a file on the worker thread
+ *  @param[in] filename Name of the sprite sheet file (.t3x)
+ *  @param[in] callback Function to call once the sprite sheet is loaded (optional)
+ *  @param[in] userData User data to pass to the callback
+ *  @returns Load job handle
+ *  @retval NULL Error
+ *  @remark See C2D_FontLoadAsync. The texture is always placed in linear memory.
+ */
+C2D_LoadJob C2D_SpriteSheetLoadAsync(const char* filename, C2D_LoadCallback callback, void* userData);
+
+/** @brief Check whether a load job has completed
+ *  @param[in] job Load job handle
+ *  @returns Status of the job
+ *  @remark If the worker thread is done with the job, it is finished on the calling thread, including running
+ *          its callback. Must be called from the thread that draws.
+ */
+C2D_LoadStatus C2D_LoadJobPoll(C2D_LoadJob job);
+
+/** @brief Retrieve the font loaded by a job
+ *  @param[in] job Load job handle
+ *  @returns Font handle, which belongs to the caller from then on
+ *  @retval NULL The job is not done or didn't load a font
+ */
+C2D_Font C2D_LoadJobGetFont(C2D_LoadJob job);
+
+/** @brief Retrieve the sprite sheet loaded by a job
+ *  @param[in] job Load job handle
+ *  @returns Sprite sheet handle, which belongs to the caller from then on
+ *  @retval NULL The job is not done or didn't load a sprite sheet
+ */
+C2D_SpriteSheet C2D_LoadJobGetSpriteSheet(C2D_LoadJob job);
+
+/** @brief Free a load job handle
+ *  @param[in] job Load job handle
+ *  @remark If the job hasn't completed yet, it is cancelled and whatever it loads is discarded. Otherwise, the
+ *          loaded resource is not freed.
+ */
+void C2D_LoadJobFree(C2D_LoadJob job);
+
+/** @brief Finish all jobs the worker thread is done with, running their callbacks
+ *  @remark Meant to be called once per frame by applications that use callbacks. Must be called from the thread
+ *          that draws.
+ */
+void C2D_LoadJobsUpdate(void);
+
+/** @brief Wait for all queued loads and stop the worker thread
+ *  @remark Jobs completed this way still need to be finished with C2D_LoadJobPoll or C2D_LoadJobsUpdate.
+ *          The worker thread is started again if something else is loaded asynchronously, except while this
+ *          function is waiting for it to stop: loads started from other threads in the meantime fail.
+ */
+void C2D_LoadJobsFini(void);
+
+/** @} */
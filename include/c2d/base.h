@@ -207,6 +207,18 @@ static inline void C2D_RightImageTint(C2D_ImageTint* tint, u32 color, float blen
  */
 bool C2D_Init(size_t maxObjects);
 
+/** @brief Initialize citro2d with multiple frames worth of vertex storage
+ *  @param[in] maxObjects Maximum number of 2D objects that can be drawn per frame.
+ *  @param[in] numFrames Number of frames the vertex/index buffers are rotated through.
+ *  @remarks C2D_Init is equivalent to passing 1 for numFrames, in which case every frame reuses
+ *           the same buffers and the next frame must not be built until the GPU is done with the
+ *           previous one (i.e. C3D_FRAME_SYNCDRAW). Passing 2 or more allows the CPU to build the
+ *           next frame while the GPU is still drawing the previous one(s), at the cost of
+ *           numFrames times the linear memory.
+ *  @returns true on success, false on failure
+ */
+bool C2D_InitEx(size_t maxObjects, size_t numFrames);
+
 /** @brief Deinitialize citro2d */
 void C2D_Fini(void);
 
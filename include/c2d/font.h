@@ -19,6 +19,17 @@ typedef struct C2D_Font_s* C2D_Font;
  */
 C2D_Font C2D_FontLoad(const char* filename);
 
+/** @brief Load a font from a file, sharing it with other users of the same file
+ * @param[in] filename Name of the font file (.bcfnt)
+ * @returns Font handle
+ * @retval NULL Error
+ * @remark If a font was already loaded from the same file name with this function and hasn't been freed by all
+ *         of its users, the same handle is returned instead of loading another copy. Each successful call must be
+ *         matched by a call to C2D_FontFree, the font is only freed once the last user frees it.
+ *         Since the font is shared, settings such as its texture filter apply to all of its users.
+ */
+C2D_Font C2D_FontLoadShared(const char* filename);
+
 /** @brief Load a font from memory
  * @param[in] data Data to load
  * @param[in] size Size of the data to load
@@ -27,6 +38,27 @@ C2D_Font C2D_FontLoad(const char* filename);
  */
 C2D_Font C2D_FontLoadFromMem(const void* data, size_t size);
 
+/** @brief Create a font from data in linear memory, taking ownership of it
+ * @param[in] data Font data (.bcfnt), allocated with linearAlloc
+ * @param[in] size Size of the data
+ * @returns Font handle
+ * @retval NULL Error, in which case the data still belongs to the caller
+ * @remark Unlike C2D_FontLoadFromMem, the data is not copied: its pointers are fixed up in place and the
+ *         glyph sheets are drawn from it directly. It is freed with linearFree by C2D_FontFree.
+ */
+C2D_Font C2D_FontAdoptMem(void* data, size_t size);
+
+/** @brief Create a font from data in linear memory that remains owned by the caller
+ * @param[in] data Font data (.bcfnt), in linear memory
+ * @param[in] size Size of the data
+ * @returns Font handle
+ * @retval NULL Error
+ * @remark Like C2D_FontAdoptMem, the data is modified in place and used directly, but C2D_FontFree doesn't free it.
+ *         The data must stay valid until the font is freed, and can't be used to create another font afterwards
+ *         since its pointers are already fixed up.
+ */
+C2D_Font C2D_FontBorrowMem(void* data, size_t size);
+
 /** @brief Load a font from file descriptor
  * @param[in] fd File descriptor used to load data
  * @returns Font handle
@@ -41,16 +73,33 @@ C2D_Font C2D_FontLoadFromFD(int fd);
  */
 C2D_Font C2D_FontLoadFromHandle(FILE* f);
 
+/** @brief Load a font from a file, keeping only its metadata in memory
+ *  @param[in] filename Name of the font file (.bcfnt)
+ *  @param[in] sheetBudget Amount of linear memory the glyph sheets may use, in bytes (0 for no limit)
+ *  @returns Font handle
+ *  @retval NULL Error
+ *  @remark The glyph sheets are read from the file as text referencing them is parsed or drawn, which keeps
+ *          the memory usage of large fonts (such as CJK fonts) proportional to the glyphs actually in use.
+ *          When loading a sheet would exceed the budget, the least recently used sheets are freed first;
+ *          sheets used in frames the GPU may still be working on are kept, even if that exceeds the budget.
+ *          The file is kept open until the font is freed.
+ */
+C2D_Font C2D_FontLoadStreamed(const char* filename, size_t sheetBudget);
+
 /** @brief Load corresponding font from system archive
  *  @param[in] region Region to get font from
  *  @returns Font handle
  *  @retval NULL Error
  *  @remark JPN, USA, EUR, and AUS all use the same font.
+ *  @remark The font is shared in the same way as with C2D_FontLoadShared: loading the font of a region whose
+ *          font is already loaded returns the same handle, which is freed once every user has called C2D_FontFree.
  */
 C2D_Font C2D_FontLoadSystem(CFG_Region region);
 
 /** @brief Free a font
  * @param[in] font Font handle
+ * @remark Font data passed to C2D_FontBorrowMem is left to the caller, everything else is freed.
+ * @remark Shared fonts (see C2D_FontLoadShared) are only freed when their last user frees them.
  */
 void C2D_FontFree(C2D_Font font);
 
@@ -61,6 +110,19 @@ void C2D_FontFree(C2D_Font font);
  */
 void C2D_FontSetFilter(C2D_Font font, GPU_TEXTURE_FILTER_PARAM magFilter, GPU_TEXTURE_FILTER_PARAM minFilter);
 
+/** @brief Set whether a font's glyph sheets hold signed distance fields
+ * @param[in] font Font handle
+ * @param[in] enable Whether to draw the font's glyphs as distance fields
+ * @remark Distance field fonts are made from regular ones with the sdffont tool. Their text is drawn by
+ *         thresholding the field, so a single small font can be used for several text sizes. The font's texture
+ *         filter must be linear (the default).
+ * @remark The edge of the glyphs is 1/32 of the field wide, i.e. spread/16 texels of the font for a field made
+ *         with a given spread. With the default spread of 4 that is a quarter of a texel: edges are about one pixel
+ *         wide up to 4x magnification, and become softer beyond that (two pixels at 8x). Text drawn smaller than
+ *         the font itself gets aliased edges. The field is 8-bit, so the edge has about 8 levels of coverage.
+ */
+void C2D_FontSetDistanceField(C2D_Font font, bool enable);
+
 /** @brief Find the glyph index of a codepoint, or returns the default
  * @param[in] font Font to search, or NULL for system font
  * @param[in] codepoint Codepoint to search for
@@ -92,4 +154,24 @@ void C2D_FontCalcGlyphPos(C2D_Font font, fontGlyphPos_s* out, int glyphIndex, u3
  */
 FINF_s* C2D_FontGetInfo(C2D_Font font);
 
+/** @brief Enables a glyph atlas for a font.
+ * @param[in] font Font whose glyphs are put in the atlas, or NULL for the system font
+ * @param[in] width Width of the atlas texture (power of two between 8 and 1024).
+ * @param[in] height Height of the atlas texture (power of two between 8 and 1024).
+ * @returns true on success, false on failure.
+ * @remarks Glyphs of the font are copied into the atlas the first time they're drawn, so that most text
+ *          can be drawn from a single texture instead of switching between the many small glyph sheets of the font.
+ *          When the atlas is full, the least recently drawn glyphs are replaced, except those drawn in frames the GPU
+ *          may still be working on; glyphs that can't be placed are drawn from their glyph sheet as usual.
+ *          Baked text (see C2D_TextBake) always uses the glyph sheets.
+ * @remarks There is a single atlas: enabling it for a font disables it for the previous one. The atlas keeps a
+ *          reference to the font, which is released by C2D_FontAtlasFini.
+ */
+bool C2D_FontAtlasInit(C2D_Font font, u16 width, u16 height);
+
+/** @brief Disables the glyph atlas and frees it.
+ * @remarks Must not be called while text drawn from the atlas may still be in use by the GPU.
+ */
+void C2D_FontAtlasFini(void);
+
 /** @} */
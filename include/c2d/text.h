@@ -9,6 +9,15 @@
 struct C2D_TextBuf_s;
 typedef struct C2D_TextBuf_s* C2D_TextBuf;
 
+struct C2D_TextArena_s;
+typedef struct C2D_TextArena_s* C2D_TextArena;
+
+struct C2D_TextLayout_s;
+typedef struct C2D_TextLayout_s* C2D_TextLayout;
+
+struct C2D_BakedText_s;
+typedef struct C2D_BakedText_s* C2D_BakedText;
+
 /** @defgroup Text Text drawing functions
  *  @{
  */
@@ -35,8 +44,33 @@ enum
 	C2D_AlignJustified   = 3 << 2, ///< Draws text justified. When C2D_WordWrap is not specified, right edge is x + scaleX*text->width. Otherwise, right edge is x + the width specified for those values.
 	C2D_AlignMask        = 3 << 2, ///< Bitmask for alignment values.
 	C2D_WordWrap         = BIT(4), ///< Draws text with wrapping of full words before specified width. Requires a float value, passed after color if C2D_WithColor is specified.
+	C2D_WithShadow       = BIT(5), ///< Draws a drop shadow behind the text. Requires a u32 color value and two float values (horizontal and vertical offset in pixels), passed after the wrap width if C2D_WordWrap is specified.
+	C2D_WithOutline      = BIT(6), ///< Draws an outline around the text. Requires a u32 color value and a float value (thickness in pixels), passed after the shadow parameters if C2D_WithShadow is specified.
+	C2D_WithClip         = BIT(7), ///< Only draws the parts of the text within a rectangle. Requires four float values (x, y, width and height of the rectangle), passed after the outline parameters if C2D_WithOutline is specified.
+};
+
+enum
+{
+	C2D_ParseOptimize    = BIT(0), ///< Groups the glyphs by glyph sheet right after parsing, as C2D_TextOptimize would.
+	C2D_ParseColorMarkup = BIT(1), ///< Interprets color markup: {#RRGGBB} or {#RRGGBBAA} colors the glyphs that follow, {#} goes back to the color passed when drawing, and {{ stands for {.
+};
+
+/// Number formatting flags.
+enum
+{
+	C2D_NumPlusSign      = BIT(0), ///< Writes a plus sign before positive numbers.
+	C2D_NumGrouping      = BIT(1), ///< Separates groups of three integer digits with commas.
+	C2D_NumFixedWidth    = BIT(2), ///< Gives every digit the advance of the widest one, so that changing numbers don't jitter.
 };
 
+/// Number format used by C2D_TextParseInt and C2D_TextParseFloat.
+typedef struct
+{
+	u32 flags;    ///< Number formatting flags (C2D_Num*).
+	u8 minDigits; ///< Minimum number of integer digits, padded with leading zeros (at most 32).
+	u8 decimals;  ///< Number of digits after the decimal point (at most 9). Ignored by C2D_TextParseInt.
+} C2D_NumFormat;
+
 /** @brief Creates a new text buffer.
  *  @param[in] maxGlyphs Maximum number of glyphs that can be stored in the buffer.
  *  @returns Text buffer handle (or NULL on failure).
@@ -69,16 +103,55 @@ void C2D_TextBufClear(C2D_TextBuf buf);
  */
 size_t C2D_TextBufGetNumGlyphs(C2D_TextBuf buf);
 
+/** @brief Creates a new text arena, a frame-scoped store of text that grows as needed.
+ *  @param[in] chunkGlyphs Number of glyphs to allocate at a time.
+ *  @returns Text arena handle (or NULL on failure).
+ *  @remarks The arena is cleared automatically at the end of every frame (see C3D_FrameEnd), so text
+ *           parsed into it must be drawn during the frame it was parsed in. Growing the arena never moves
+ *           the glyphs of existing text objects.
+ */
+C2D_TextArena C2D_TextArenaNew(size_t chunkGlyphs);
+
+/** @brief Deletes a text arena.
+ *  @param[in] arena Text arena handle.
+ *  @remarks This also invalidates all text objects previously created with this arena.
+ */
+void C2D_TextArenaDelete(C2D_TextArena arena);
+
+/** @brief Clears all stored text in an arena ahead of the end of the frame.
+ *  @param[in] arena Text arena handle.
+ *  @remarks If the arena had to grow, its storage is merged into a single chunk large enough for the peak
+ *           usage so far, so that frames that don't need more text than that don't allocate.
+ */
+void C2D_TextArenaClear(C2D_TextArena arena);
+
+/** @brief Retrieves the highest number of glyphs stored in an arena during a single frame.
+ *  @param[in] arena Text arena handle.
+ *  @returns The peak number of glyphs.
+ */
+size_t C2D_TextArenaGetPeak(C2D_TextArena arena);
+
+/** @brief Parses and adds arbitrary text (including newlines) to a text arena, growing it as needed.
+ *  @param[out] text Pointer to text object to store information in.
+ *  @param[in] font Font to get glyphs from, or null for system font
+ *  @param[in] arena Text arena handle.
+ *  @param[in] str String to parse.
+ *  @param[in] flags Text parsing flags (C2D_Parse*).
+ *  @returns On success, a pointer to the null character at the end of the string. On failure, NULL.
+ */
+const char* C2D_TextArenaParse(C2D_Text* text, C2D_Font font, C2D_TextArena arena, const char* str, u32 flags);
+
 /** @brief Parses and adds a single line of text to a text buffer.
  *  @param[out] text Pointer to text object to store information in.
  *  @param[in] buf Text buffer handle.
  *  @param[in] str String to parse.
- *  @param[in] lineNo Line number assigned to the text (used to calculate vertical position).
+ *  @param[in] lineNo Line number assigned to the text (used to calculate vertical position), larger than 65535 is treated as 65535.
  *  @remarks Whitespace doesn't add any glyphs to the text buffer and is thus "free".
  *  @returns On success, a pointer to the character on which string processing stopped, which
  *           can be a newline ('\n'; indicating that's where the line ended), the null character
  *           ('\0'; indicating the end of the string was reached), or any other character
- *           (indicating the text buffer is full and no more glyphs can be added).
+ *           (indicating the text buffer is full and no more glyphs can be added, or that the line has
+ *           65536 words, the most a line can have).
  *           On failure, NULL.
  */
 const char* C2D_TextParseLine(C2D_Text* text, C2D_TextBuf buf, const char* str, u32 lineNo);
@@ -88,12 +161,13 @@ const char* C2D_TextParseLine(C2D_Text* text, C2D_TextBuf buf, const char* str,
  *  @param[in] font Font to get glyphs from, or null for system font
  *  @param[in] buf Text buffer handle.
  *  @param[in] str String to parse.
- *  @param[in] lineNo Line number assigned to the text (used to calculate vertical position).
+ *  @param[in] lineNo Line number assigned to the text (used to calculate vertical position), larger than 65535 is treated as 65535.
  *  @remarks Whitespace doesn't add any glyphs to the text buffer and is thus "free".
  *  @returns On success, a pointer to the character on which string processing stopped, which
  *           can be a newline ('\n'; indicating that's where the line ended), the null character
  *           ('\0'; indicating the end of the string was reached), or any other character
- *           (indicating the text buffer is full and no more glyphs can be added).
+ *           (indicating the text buffer is full and no more glyphs can be added, or that the line has
+ *           65536 words, the most a line can have).
  *           On failure, NULL.
  */
 const char* C2D_TextFontParseLine(C2D_Text* text, C2D_Font font, C2D_TextBuf buf, const char* str, u32 lineNo);
@@ -105,7 +179,9 @@ const char* C2D_TextFontParseLine(C2D_Text* text, C2D_Font font, C2D_TextBuf buf
  *  @remarks Whitespace doesn't add any glyphs to the text buffer and is thus "free".
  *  @returns On success, a pointer to the character on which string processing stopped, which
  *           can be the null character ('\0'; indicating the end of the string was reached),
- *           or any other character (indicating the text buffer is full and no more glyphs can be added).
+ *           a newline ('\n'; indicating the text has 65536 lines, the most a text object can have),
+ *           or any other character (indicating the text buffer is full and no more glyphs can be added,
+ *           or that the line has 65536 words, the most a line can have).
  *           On failure, NULL.
  */
 const char* C2D_TextParse(C2D_Text* text, C2D_TextBuf buf, const char* str);
@@ -118,13 +194,102 @@ const char* C2D_TextParse(C2D_Text* text, C2D_TextBuf buf, const char* str);
  *  @remarks Whitespace doesn't add any glyphs to the text buffer and is thus "free".
  *  @returns On success, a pointer to the character on which string processing stopped, which
  *           can be the null character ('\0'; indicating the end of the string was reached),
- *           or any other character (indicating the text buffer is full and no more glyphs can be added).
+ *           a newline ('\n'; indicating the text has 65536 lines, the most a text object can have),
+ *           or any other character (indicating the text buffer is full and no more glyphs can be added,
+ *           or that the line has 65536 words, the most a line can have).
  *           On failure, NULL.
  */
 const char* C2D_TextFontParse(C2D_Text* text, C2D_Font font, C2D_TextBuf buf, const char* str);
 
+/** @brief Adds an integer to a text buffer, without going through a formatted string.
+ *  @param[out] text Pointer to text object to store information in.
+ *  @param[in] font Font to get glyphs from, or null for system font
+ *  @param[in] buf Text buffer handle.
+ *  @param[in] value Number to add.
+ *  @param[in] fmt Number format, or NULL for plain digits.
+ *  @returns true if the whole number was added, false if the text buffer became full.
+ */
+bool C2D_TextParseInt(C2D_Text* text, C2D_Font font, C2D_TextBuf buf, s64 value, const C2D_NumFormat* fmt);
+
+/** @brief Adds a decimal number to a text buffer, without going through a formatted string.
+ *  @param[out] text Pointer to text object to store information in.
+ *  @param[in] font Font to get glyphs from, or null for system font
+ *  @param[in] buf Text buffer handle.
+ *  @param[in] value Number to add, rounded to the number of decimals of the format.
+ *  @param[in] fmt Number format, or NULL for no decimals.
+ *  @returns true if the whole number was added, false if the text buffer became full.
+ *  @remarks Numbers too large to be written digit by digit (about 1.8e19 once scaled by the decimals),
+ *           infinities and NaN are formatted with snprintf instead.
+ */
+bool C2D_TextParseFloat(C2D_Text* text, C2D_Font font, C2D_TextBuf buf, double value, const C2D_NumFormat* fmt);
+
+/** @brief Parses and adds arbitrary text (including newlines) to a text buffer, with extra options.
+ *  @param[out] text Pointer to text object to store information in.
+ *  @param[in] font Font to get glyphs from, or null for system font
+ *  @param[in] buf Text buffer handle.
+ *  @param[in] str String to parse.
+ *  @param[in] flags Text parsing flags (C2D_Parse*).
+ *  @returns Same as C2D_TextFontParse.
+ *  @remarks With C2D_ParseColorMarkup, each glyph remembers its color, so multi-colored text can be wrapped
+ *           and drawn as a single text object. The colors are stored in the text buffer (up to 65535 different
+ *           ones until it is cleared). The color passed when drawing only applies to glyphs without a markup
+ *           color, and shadows and outlines use their own color.
+ */
+const char* C2D_TextFontParseEx(C2D_Text* text, C2D_Font font, C2D_TextBuf buf, const char* str, u32 flags);
+
+/** @brief Loads strings pre-parsed by the strtab tool (see tools/strtab.c) into text objects.
+ *  @param[out] texts Array of text objects to fill in, in the order of the strings in the table.
+ *  @param[in] numTexts Number of text objects to fill in (at most the number of strings in the table).
+ *  @param[in] font Font the table was made for, or null for system font
+ *  @param[in] data String table data, 4-byte aligned.
+ *  @param[in] size Size of the string table data.
+ *  @returns New text buffer holding the glyphs of the strings, to be freed with C2D_TextBufDelete.
+ *  @retval NULL Error, including a table made for a font with a different glyph sheet layout, or whose line and
+ *          word numbers don't match its strings.
+ *  @remarks The glyphs are copied as they are, so none of the strings go through the parser at runtime.
+ *           The resulting text objects can be used like parsed ones, except that C2D_TextUpdate parses
+ *           them from scratch the first time.
+ */
+C2D_TextBuf C2D_TextTableLoad(C2D_Text* texts, size_t numTexts, C2D_Font font, const void* data, size_t size);
+
+/** @brief Parses many strings at once, spreading the work across the available CPU cores.
+ *  @param[out] texts Array of text objects to fill in, one per string.
+ *  @param[in] font Font to use, or null for system font
+ *  @param[in] strs Strings to parse (may include newlines).
+ *  @param[in] numStrs Number of strings.
+ *  @param[in] flags Text parsing flags (C2D_Parse*), applied to every string.
+ *  @param[in] maxThreads Maximum number of threads to parse with, including the calling one (0 for no limit).
+ *  @returns New text buffer holding the glyphs of the strings, to be freed with C2D_TextBufDelete.
+ *  @retval NULL Out of memory.
+ *  @remarks The text objects are the same as if each string had been parsed in order with C2D_TextFontParseEx.
+ *           On the 3DS, the extra threads run on the New 3DS application core and on the system core if the
+ *           application was given time on it (see APT_SetAppCpuTimeLimit), otherwise everything is parsed
+ *           on the calling thread. The font must not be used by other threads while this runs. Glyph sheets
+ *           of streamed fonts are loaded when the text objects are first drawn.
+ */
+C2D_TextBuf C2D_TextFontParseMany(C2D_Text* texts, C2D_Font font, const char* const* strs, size_t numStrs, u32 flags, u32 maxThreads);
+
+/** @brief Replaces the contents of a text object, only re-parsing the part of the string that changed.
+ *  @param[in,out] text Pointer to a text object previously filled in by one of the parse functions.
+ *  @param[in] str New string to parse (may include newlines).
+ *  @remarks The text object keeps the font and text buffer it was originally parsed with. The first call
+ *           parses the whole string and remembers it; subsequent calls keep the glyphs produced by the
+ *           unchanged beginning of the string and only parse the rest, which is ideal for counters and
+ *           timers. If the text object is the last one in its buffer it can grow up to the capacity of
+ *           the buffer, otherwise it can't grow past the glyphs it occupied when first updated.
+ *           Clearing the buffer or calling C2D_TextOptimize on the text object discards what was remembered.
+ *  @remarks A text object parsed with C2D_ParseColorMarkup keeps interpreting markup, unless it had no glyphs
+ *           when first updated (it is then parsed without it, like the other flags of C2D_TextFontParseEx).
+ *  @returns Same as C2D_TextParse.
+ */
+const char* C2D_TextUpdate(C2D_Text* text, const char* str);
+
 /** @brief Optimizes a text object in order to be drawn more efficiently.
  *  @param[in] text Pointer to text object.
+ *  @remarks Glyphs are grouped by glyph sheet (keeping their order within each sheet), which
+ *           minimizes the number of texture switches needed to draw the text.
+ *  @remarks The temporary memory used for this is kept by the text buffer and reused by later calls. If it
+ *           can't be allocated, the glyphs are grouped in place instead, which is slower for long texts.
  */
 void C2D_TextOptimize(const C2D_Text* text);
 
@@ -147,8 +312,111 @@ void C2D_TextGetDimensions(const C2D_Text* text, float scaleX, float scaleY, flo
  *  @param[in] z Depth value of the text. If unsure, pass 0.0f.
  *  @param[in] scaleX Horizontal size of the font. 1.0f corresponds to the native size of the font.
  *  @param[in] scaleY Vertical size of the font. 1.0f corresponds to the native size of the font.
+ *  @returns true on success, false on failure (nothing is drawn if the text does not fit in the vertex buffer,
+ *           or if there is no memory left to lay out long wrapped or justified text).
  *  @remarks The default 3DS system font has a glyph height of 30px, and the baseline is at 25px.
+ *  @remarks C2D_WithShadow and C2D_WithOutline draw offset copies of every glyph behind the text (one for the
+ *           shadow, eight for the outline), in the same batch as the text itself: the glyphs of each texture
+ *           are drawn with all their layers, back to front, so the number of texture switches doesn't change.
+ *           A shadow may thus be drawn over text that uses another texture. The text is only laid out once, but
+ *           needs as many times more room in the vertex buffer.
+ *  @remarks C2D_WithClip skips the glyphs outside of the rectangle and cuts the ones that straddle its edges,
+ *           without changing the scissor state, so that clipped text doesn't break batches. The rectangle uses
+ *           the same coordinates as x and y, before the transformations of C2D_ViewTranslate and such.
+ */
+bool C2D_DrawText(const C2D_Text* text, u32 flags, float x, float y, float z, float scaleX, float scaleY, ...);
+
+/** @brief Draws a range of lines of a text object using the GPU.
+ *  @param[in] text Pointer to text object.
+ *  @param[in] flags Text drawing flags.
+ *  @param[in] firstLine First line to draw, counting the lines added by C2D_WordWrap.
+ *  @param[in] numLines Number of lines to draw.
+ *  @param[in] x Horizontal position to draw the text on (see C2D_DrawText).
+ *  @param[in] y Vertical position to draw the text on (see C2D_DrawText).
+ *  @param[in] z Depth value of the text. If unsure, pass 0.0f.
+ *  @param[in] scaleX Horizontal size of the font. 1.0f corresponds to the native size of the font.
+ *  @param[in] scaleY Vertical size of the font. 1.0f corresponds to the native size of the font.
+ *  @returns true on success, false on failure (nothing is drawn if the lines do not fit in the vertex buffer,
+ *           or if there is no memory left to lay out long wrapped or justified text).
+ *  @remarks The lines are placed exactly where C2D_DrawText would place them, the rest of the text is skipped.
+ *           Unless C2D_WordWrap or C2D_AlignJustified is used, or the text was optimized (see C2D_TextOptimize),
+ *           the cost only depends on the number of glyphs in the drawn lines, which makes it suitable for
+ *           scrolling through very long text.
+ */
+bool C2D_DrawTextLines(const C2D_Text* text, u32 flags, u32 firstLine, u32 numLines, float x, float y, float z, float scaleX, float scaleY, ...);
+
+/** @brief Calculates which lines of a text object overlap a vertical span of the screen.
+ *  @param[in] text Pointer to text object.
+ *  @param[in] flags Text drawing flags (only C2D_AtBaseline is used).
+ *  @param[in] y Vertical position the text is drawn on (see C2D_DrawText).
+ *  @param[in] scaleY Vertical size of the font. 1.0f corresponds to the native size of the font.
+ *  @param[in] top Top of the visible span, such as the top of a clipping rectangle.
+ *  @param[in] bottom Bottom of the visible span.
+ *  @param[out] outFirstLine Variable in which to store the first visible line.
+ *  @param[out] outNumLines Variable in which to store the number of visible lines (possibly past the end of the text).
+ *  @remarks The results can be passed to C2D_DrawTextLines.
+ */
+void C2D_TextGetVisibleLines(const C2D_Text* text, u32 flags, float y, float scaleY, float top, float bottom, u32* outFirstLine, u32* outNumLines);
+
+/** @brief Calculates the final position of every glyph of a text object, so that it can be drawn repeatedly.
+ *  @param[in] text Pointer to text object.
+ *  @param[in] flags Text drawing flags (C2D_AtBaseline, alignment and C2D_WordWrap; C2D_WithColor is ignored).
+ *  @param[in] scaleX Horizontal size of the font. 1.0f corresponds to the native size of the font.
+ *  @param[in] scaleY Vertical size of the font. 1.0f corresponds to the native size of the font.
+ *  @param[in] wrapWidth Width at which words are wrapped. Only used if C2D_WordWrap is specified.
+ *  @returns Text layout handle (or NULL on failure).
+ *  @remarks The layout refers to the glyphs of the text object, so the text object must stay valid
+ *           (and its text buffer must not be cleared) for as long as the layout is used.
+ */
+C2D_TextLayout C2D_TextLayoutNew(const C2D_Text* text, u32 flags, float scaleX, float scaleY, float wrapWidth);
+
+/** @brief Deletes a text layout.
+ *  @param[in] layout Text layout handle.
+ */
+void C2D_TextLayoutDelete(C2D_TextLayout layout);
+
+/** @brief Retrieves the total dimensions of a text layout, after wrapping.
+ *  @param[in] layout Text layout handle.
+ *  @param[out] outWidth (optional) Variable in which to store the width of the text.
+ *  @param[out] outHeight (optional) Variable in which to store the height of the text.
+ */
+void C2D_TextLayoutGetDimensions(C2D_TextLayout layout, float* outWidth, float* outHeight);
+
+/** @brief Draws a text layout using the GPU.
+ *  @param[in] layout Text layout handle.
+ *  @param[in] x Horizontal position to draw the text on.
+ *  @param[in] y Vertical position to draw the text on (see C2D_DrawText).
+ *  @param[in] z Depth value of the text. If unsure, pass 0.0f.
+ *  @param[in] color 32-bit RGBA color of the text.
+ *  @returns true on success, false on failure (nothing is drawn if the text does not fit in the vertex buffer).
+ */
+bool C2D_DrawTextLayout(C2D_TextLayout layout, float x, float y, float z, u32 color);
+
+/** @brief Bakes a text object into a block of ready-made vertices, grouped by glyph sheet.
+ *  @param[in] text Pointer to text object.
+ *  @param[in] flags Text drawing flags, same as C2D_DrawText except for C2D_WithClip.
+ *  @param[in] scaleX Horizontal size of the font. 1.0f corresponds to the native size of the font.
+ *  @param[in] scaleY Vertical size of the font. 1.0f corresponds to the native size of the font.
+ *  @returns Baked text handle (or NULL on failure, including when C2D_WithClip is passed).
+ *  @remarks The color, wrap width, shadow and outline arguments are passed in the same way as in C2D_DrawText,
+ *           and the baked text looks the same as text drawn with them. C2D_WithClip is not supported, since the
+ *           position of baked text is only known when it is drawn.
+ *           Unlike text layouts, baked text doesn't refer to the text object afterwards.
+ */
+C2D_BakedText C2D_TextBake(const C2D_Text* text, u32 flags, float scaleX, float scaleY, ...);
+
+/** @brief Deletes baked text.
+ *  @param[in] baked Baked text handle.
+ */
+void C2D_BakedTextDelete(C2D_BakedText baked);
+
+/** @brief Draws baked text using the GPU.
+ *  @param[in] baked Baked text handle.
+ *  @param[in] x Horizontal position to draw the text on.
+ *  @param[in] y Vertical position to draw the text on (see C2D_DrawText).
+ *  @param[in] z Depth value of the text. If unsure, pass 0.0f.
+ *  @returns true on success, false if there isn't enough space left in the vertex buffer for the whole text.
  */
-void C2D_DrawText(const C2D_Text* text, u32 flags, float x, float y, float z, float scaleX, float scaleY, ...);
+bool C2D_DrawBakedText(C2D_BakedText baked, float x, float y, float z);
 
 /** @} */
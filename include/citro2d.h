@@ -20,6 +20,7 @@ extern "C" {
 #include "c2d/sprite.h"
 #include "c2d/text.h"
 #include "c2d/font.h"
+#include "c2d/async.h"
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,257 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "internal.h"
+#include <c2d/async.h>
+
+struct C2D_LoadJob_s
+{
+	C2D_LoadJob next; // Next job in the pending or loaded queue
+	const C2Di_LoadOps* ops;
+	C2D_LoadCallback callback;
+	void* userData;
+	void* result;
+	C2D_LoadStatus status; // Only changes once the job is finished on the thread that draws
+	bool queued;    // Waiting for the worker thread
+	bool loaded;    // Done on the worker thread, waiting to be finished
+	bool cancelled; // Freed by the user while being loaded, the worker thread discards it
+	char filename[];
+};
+
+typedef struct
+{
+	C2D_LoadJob head, tail;
+} C2Di_LoadQueue;
+
+static struct
+{
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t thread;
+	bool running;
+	bool stopping; // C2D_LoadJobsFini is waiting for the worker thread, which may not be restarted until then
+	bool quit;
+	C2Di_LoadQueue pending;
+	C2Di_LoadQueue loaded;
+} s_loader = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static void C2Di_LoadQueuePush(C2Di_LoadQueue* queue, C2D_LoadJob job)
+{
+	job->next = NULL;
+	if (queue->tail)
+		queue->tail->next = job;
+	else
+		queue->head = job;
+	queue->tail = job;
+}
+
+static void C2Di_LoadQueueRemove(C2Di_LoadQueue* queue, C2D_LoadJob job)
+{
+	C2D_LoadJob* link = &queue->head;
+	C2D_LoadJob prev = NULL;
+	while (*link != job)
+	{
+		prev = *link;
+		link = &prev->next;
+	}
+	*link = job->next;
+	if (queue->tail == job)
+		queue->tail = prev;
+}
+
+static void* C2Di_LoadWorker(void* unused)
+{
+#ifdef __3DS__
+	// Run below the thread that started loading, so that decompression doesn't hold up rendering on the same core
+	s32 prio = 0x30;
+	svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+	if (prio < 0x3F)
+		svcSetThreadPriority(CUR_THREAD_HANDLE, prio+1);
+#endif
+
+	pthread_mutex_lock(&s_loader.lock);
+	for (;;)
+	{
+		while (!s_loader.pending.head && !s_loader.quit)
+			pthread_cond_wait(&s_loader.cond, &s_loader.lock);
+
+		// Remaining jobs are still loaded when quitting
+		C2D_LoadJob job = s_loader.pending.head;
+		if (!job)
+			break;
+		C2Di_LoadQueueRemove(&s_loader.pending, job);
+		job->queued = false;
+		pthread_mutex_unlock(&s_loader.lock);
+
+		void* result = job->ops->load(job->filename);
+
+		pthread_mutex_lock(&s_loader.lock);
+		if (job->cancelled)
+		{
+			pthread_mutex_unlock(&s_loader.lock);
+			if (result)
+				job->ops->discard(result);
+			free(job);
+			pthread_mutex_lock(&s_loader.lock);
+			continue;
+		}
+		job->result = result;
+		job->loaded = true;
+		C2Di_LoadQueuePush(&s_loader.loaded, job);
+	}
+	pthread_mutex_unlock(&s_loader.lock);
+	return NULL;
+}
+
+// Hands the result of the worker thread over to the thread that draws
+static void C2Di_LoadJobFinish(C2D_LoadJob job)
+{
+	job->loaded = false;
+	if (job->result)
+		job->result = job->ops->finish(job->result);
+	job->status = job->result ? C2D_LoadDone : C2D_LoadFailed;
+	if (job->callback)
+		job->callback(job, job->userData);
+}
+
+static C2D_LoadJob C2Di_LoadJobNew(const C2Di_LoadOps* ops, const char* filename, C2D_LoadCallback callback, void* userData)
+{
+	size_t len = strlen(filename);
+	C2D_LoadJob job = (C2D_LoadJob)malloc(sizeof(struct C2D_LoadJob_s) + len + 1);
+	if (!job)
+		return NULL;
+
+	job->ops       = ops;
+	job->callback  = callback;
+	job->userData  = userData;
+	job->result    = NULL;
+	job->status    = C2D_LoadPending;
+	job->queued    = true;
+	job->loaded    = false;
+	job->cancelled = false;
+	memcpy(job->filename, filename, len + 1);
+
+	pthread_mutex_lock(&s_loader.lock);
+	if (s_loader.stopping)
+	{
+		pthread_mutex_unlock(&s_loader.lock);
+		free(job);
+		return NULL;
+	}
+	if (!s_loader.running)
+	{
+		s_loader.quit = false;
+		if (pthread_create(&s_loader.thread, NULL, C2Di_LoadWorker, NULL) != 0)
+		{
+			pthread_mutex_unlock(&s_loader.lock);
+			free(job);
+			return NULL;
+		}
+		s_loader.running = true;
+	}
+	C2Di_LoadQueuePush(&s_loader.pending, job);
+	pthread_cond_signal(&s_loader.cond);
+	pthread_mutex_unlock(&s_loader.lock);
+	return job;
+}
+
+C2D_LoadJob C2D_FontLoadAsync(const char* filename, C2D_LoadCallback callback, void* userData)
+{
+	return C2Di_LoadJobNew(&C2Di_FontLoadOps, filename, callback, userData);
+}
+
+C2D_LoadJob C2D_SpriteSheetLoadAsync(const char* filename, C2D_LoadCallback callback, void* userData)
+{
+	return C2Di_LoadJobNew(&C2Di_SpriteSheetLoadOps, filename, callback, userData);
+}
+
+C2D_LoadStatus C2D_LoadJobPoll(C2D_LoadJob job)
+{
+	if (job->status == C2D_LoadPending)
+	{
+		pthread_mutex_lock(&s_loader.lock);
+		bool loaded = job->loaded;
+		if (loaded)
+			C2Di_LoadQueueRemove(&s_loader.loaded, job);
+		pthread_mutex_unlock(&s_loader.lock);
+
+		if (loaded)
+			C2Di_LoadJobFinish(job);
+	}
+	return job->status;
+}
+
+C2D_Font C2D_LoadJobGetFont(C2D_LoadJob job)
+{
+	if (job->status != C2D_LoadDone || job->ops != &C2Di_FontLoadOps)
+		return NULL;
+	return (C2D_Font)job->result;
+}
+
+C2D_SpriteSheet C2D_LoadJobGetSpriteSheet(C2D_LoadJob job)
+{
+	if (job->status != C2D_LoadDone || job->ops != &C2Di_SpriteSheetLoadOps)
+		return NULL;
+	return (C2D_SpriteSheet)job->result;
+}
+
+void C2D_LoadJobFree(C2D_LoadJob job)
+{
+	if (!job)
+		return;
+
+	if (job->status == C2D_LoadPending)
+	{
+		pthread_mutex_lock(&s_loader.lock);
+		if (!job->queued && !job->loaded)
+		{
+			// Being loaded right now, leave it to the worker thread
+			job->cancelled = true;
+			pthread_mutex_unlock(&s_loader.lock);
+			return;
+		}
+		C2Di_LoadQueueRemove(job->queued ? &s_loader.pending : &s_loader.loaded, job);
+		pthread_mutex_unlock(&s_loader.lock);
+
+		if (job->result)
+			job->ops->discard(job->result);
+	}
+	free(job);
+}
+
+void C2D_LoadJobsUpdate(void)
+{
+	// One job at a time, since callbacks may poll or free other jobs
+	for (;;)
+	{
+		pthread_mutex_lock(&s_loader.lock);
+		C2D_LoadJob job = s_loader.loaded.head;
+		if (job)
+			C2Di_LoadQueueRemove(&s_loader.loaded, job);
+		pthread_mutex_unlock(&s_loader.lock);
+
+		if (!job)
+			break;
+		C2Di_LoadJobFinish(job);
+	}
+}
+
+void C2D_LoadJobsFini(void)
+{
+	pthread_mutex_lock(&s_loader.lock);
+	bool join = s_loader.running && !s_loader.stopping; // Only one caller waits for the thread
+	s_loader.quit = true;
+	if (join)
+		s_loader.stopping = true;
+	pthread_cond_signal(&s_loader.cond);
+	pthread_mutex_unlock(&s_loader.lock);
+
+	if (!join)
+		return;
+	pthread_join(s_loader.thread, NULL);
+
+	pthread_mutex_lock(&s_loader.lock);
+	s_loader.running  = false;
+	s_loader.stopping = false;
+	pthread_mutex_unlock(&s_loader.lock);
+}
@@ -0,0 +1,285 @@
+#include "internal.h"
+#include <stdlib.h>
+#include <c2d/font.h>
+
+#define C2Di_ATLAS_FREE UINT16_MAX
+
+typedef struct
+{
+	u16 sheet;      // Glyph stored in the slot, or C2Di_ATLAS_FREE
+	u16 sheetGlyph;
+	u16 prev, next; // Slots in order of use, most recent first
+	u32 lastUsed;   // Frame the glyph was last drawn in
+	C2Di_Texcoord texcoord;
+} C2Di_AtlasSlot;
+
+static struct
+{
+	bool active;
+	bool dirty;
+	C2D_Font font; // Font the glyphs come from, NULL for the system font
+	C3D_Tex tex;
+	u32 bits;
+	u32 slotW, slotH;
+	u32 cols;
+	u32 numSlots;
+	C2Di_AtlasSlot* slots;
+	u16 head, tail;
+	u16** slotMaps; // Per sheet, index+1 of the slot holding each glyph (0 if none), allocated on first use
+	u32 numSheets;
+} s_atlas;
+
+static u32 C2Di_FormatBits(GPU_TEXCOLOR fmt)
+{
+	switch (fmt)
+	{
+		case GPU_RGBA8:
+			return 32;
+		case GPU_RGB8:
+			return 24;
+		case GPU_RGBA5551:
+		case GPU_RGB565:
+		case GPU_RGBA4:
+		case GPU_LA8:
+		case GPU_HILO8:
+			return 16;
+		case GPU_L8:
+		case GPU_A8:
+		case GPU_LA4:
+			return 8;
+		case GPU_L4:
+		case GPU_A4:
+			return 4;
+		default:
+			return 0; // ETC1 is compressed in 4x4 blocks, so glyphs can't be copied texel by texel
+	}
+}
+
+// Textures are made of 8x8 tiles, with the texels of each tile in Z-order
+static inline u32 C2Di_TexelIndex(u32 x, u32 y, u32 width)
+{
+	u32 morton = (x&1) | ((y&1)<<1) | ((x&2)<<1) | ((y&2)<<2) | ((x&4)<<2) | ((y&4)<<3);
+	return (((y>>3)*(width>>3) + (x>>3)) << 6) | morton;
+}
+
+static inline void C2Di_CopyTexel(u8* dst, u32 dstIndex, const u8* src, u32 srcIndex, u32 bits)
+{
+	if (bits == 4)
+	{
+		u32 dstShift = (dstIndex & 1)*4;
+		u8 texel = src ? (src[srcIndex>>1] >> ((srcIndex & 1)*4)) & 0xF : 0;
+		dst[dstIndex>>1] = (dst[dstIndex>>1] & ~(0xF << dstShift)) | (texel << dstShift);
+	} else if (src)
+		memcpy(&dst[dstIndex*bits/8], &src[srcIndex*bits/8], bits/8);
+	else
+		memset(&dst[dstIndex*bits/8], 0, bits/8);
+}
+
+static void C2Di_AtlasTouch(u32 slot)
+{
+	C2Di_AtlasSlot* s = &s_atlas.slots[slot];
+	s->lastUsed = C2Di_GetContext()->frameCount;
+	if (slot == s_atlas.head)
+		return;
+
+	// Unlink...
+	s_atlas.slots[s->prev].next = s->next;
+	if (slot == s_atlas.tail)
+		s_atlas.tail = s->prev;
+	else
+		s_atlas.slots[s->next].prev = s->prev;
+
+	// ...and put it in front
+	s->next = s_atlas.head;
+	s_atlas.slots[s_atlas.head].prev = slot;
+	s_atlas.head = slot;
+}
+
+static inline TGLP_s* C2Di_AtlasGlyphInfo(void)
+{
+	return C2D_FontGetInfo(s_atlas.font)->tglp;
+}
+
+// Texels of a glyph sheet, NULL if it isn't loaded
+static inline const u8* C2Di_AtlasSheetData(u32 sheet)
+{
+	if (s_atlas.font)
+		return (const u8*)s_atlas.font->glyphSheets[sheet].data;
+	return (const u8*)fontGetGlyphSheetTex(fontGetSystemFont(), sheet);
+}
+
+static void C2Di_AtlasStore(u32 slot, u32 sheet, u32 sheetGlyph)
+{
+	TGLP_s* tglp = C2Di_AtlasGlyphInfo();
+	const u8* src = C2Di_AtlasSheetData(sheet);
+	u8* dst = (u8*)s_atlas.tex.data;
+	u32 dstX = (slot % s_atlas.cols)*s_atlas.slotW;
+	u32 dstY = (slot / s_atlas.cols)*s_atlas.slotH;
+	u32 x, y;
+
+	C2Di_Texcoord tc;
+	const C2Di_Texcoord* texcoords = C2Di_FontGetSheetTexcoords(s_atlas.font, sheet);
+	if (texcoords)
+		tc = texcoords[sheetGlyph];
+	else
+		C2Di_FontCalcTexcoord(s_atlas.font, sheet, sheetGlyph, &tc);
+
+	// Glyph rectangle within its sheet, in texels (rows go upwards like texture coordinates)
+	u32 srcX = tc.left*tglp->sheetWidth + 0.5f;
+	u32 srcY = tc.bottom*tglp->sheetHeight + 0.5f;
+	u32 w = (u32)(tc.right*tglp->sheetWidth + 0.5f) - srcX;
+	u32 h = (u32)(tc.top*tglp->sheetHeight + 0.5f) - srcY;
+	if (w > s_atlas.slotW - 2)
+		w = s_atlas.slotW - 2;
+	if (h > s_atlas.slotH - 2)
+		h = s_atlas.slotH - 2;
+
+	// Clear the whole slot (keeping a transparent border around the glyph), then copy the glyph
+	for (y = 0; y < s_atlas.slotH; y ++)
+		for (x = 0; x < s_atlas.slotW; x ++)
+			C2Di_CopyTexel(dst, C2Di_TexelIndex(dstX+x, dstY+y, s_atlas.tex.width), NULL, 0, s_atlas.bits);
+	for (y = 0; y < h; y ++)
+		for (x = 0; x < w; x ++)
+			C2Di_CopyTexel(dst, C2Di_TexelIndex(dstX+1+x, dstY+1+y, s_atlas.tex.width),
+				src, C2Di_TexelIndex(srcX+x, srcY+y, tglp->sheetWidth), s_atlas.bits);
+
+	C2Di_AtlasSlot* s = &s_atlas.slots[slot];
+	s->sheet           = sheet;
+	s->sheetGlyph      = sheetGlyph;
+	s->texcoord.left   = (float)(dstX+1) / s_atlas.tex.width;
+	s->texcoord.right  = (float)(dstX+1+w) / s_atlas.tex.width;
+	s->texcoord.bottom = (float)(dstY+1) / s_atlas.tex.height;
+	s->texcoord.top    = (float)(dstY+1+h) / s_atlas.tex.height;
+	s_atlas.dirty = true;
+}
+
+bool C2D_FontAtlasInit(C2D_Font font, u16 width, u16 height)
+{
+	C2D_FontAtlasFini();
+
+	if (!font && !fontGetSystemFont())
+		return false;
+	s_atlas.font = font;
+	TGLP_s* tglp = C2Di_AtlasGlyphInfo();
+	s_atlas.bits = C2Di_FormatBits(tglp->sheetFmt);
+	if (!s_atlas.bits)
+		return false;
+
+	s_atlas.slotW = tglp->cellWidth + 2;
+	s_atlas.slotH = tglp->cellHeight + 2;
+	s_atlas.cols = width / s_atlas.slotW;
+	s_atlas.numSlots = s_atlas.cols * (height / s_atlas.slotH);
+	if (s_atlas.numSlots > C2Di_ATLAS_FREE)
+		s_atlas.numSlots = C2Di_ATLAS_FREE;
+	if (!s_atlas.numSlots)
+		return false;
+
+	s_atlas.numSheets = tglp->nSheets;
+	s_atlas.slots = (C2Di_AtlasSlot*)malloc(s_atlas.numSlots*sizeof(C2Di_AtlasSlot));
+	s_atlas.slotMaps = (u16**)calloc(s_atlas.numSheets, sizeof(u16*));
+	if (!s_atlas.slots || !s_atlas.slotMaps || !C3D_TexInit(&s_atlas.tex, width, height, tglp->sheetFmt))
+	{
+		free(s_atlas.slots);
+		free(s_atlas.slotMaps);
+		return false;
+	}
+	memset(s_atlas.tex.data, 0, s_atlas.tex.size);
+	C3D_TexSetFilter(&s_atlas.tex, GPU_LINEAR, GPU_LINEAR);
+	C3D_TexSetWrap(&s_atlas.tex, GPU_CLAMP_TO_BORDER, GPU_CLAMP_TO_BORDER);
+	s_atlas.tex.border = 0;
+
+	u32 i;
+	for (i = 0; i < s_atlas.numSlots; i ++)
+	{
+		s_atlas.slots[i].sheet    = C2Di_ATLAS_FREE;
+		s_atlas.slots[i].prev     = i - 1;
+		s_atlas.slots[i].next     = i + 1;
+		s_atlas.slots[i].lastUsed = 0;
+	}
+	s_atlas.head   = 0;
+	s_atlas.tail   = s_atlas.numSlots - 1;
+	s_atlas.dirty  = true;
+	s_atlas.active = true;
+	if (font)
+		font->refCount++; // Released by C2D_FontAtlasFini
+	return true;
+}
+
+void C2D_FontAtlasFini(void)
+{
+	if (!s_atlas.active)
+		return;
+
+	u32 i;
+	for (i = 0; i < s_atlas.numSheets; i ++)
+		free(s_atlas.slotMaps[i]);
+	free(s_atlas.slotMaps);
+	free(s_atlas.slots);
+	C3D_TexDelete(&s_atlas.tex);
+	C2D_FontFree(s_atlas.font);
+	s_atlas.active = false;
+}
+
+bool C2Di_AtlasHasFont(C2D_Font font)
+{
+	return s_atlas.active && s_atlas.font == font;
+}
+
+C3D_Tex* C2Di_AtlasGetTex(void)
+{
+	return &s_atlas.tex;
+}
+
+const C2Di_Texcoord* C2Di_AtlasFind(u32 sheet, u32 sheetGlyph)
+{
+	u16* map = s_atlas.slotMaps[sheet];
+	if (!map || !map[sheetGlyph])
+		return NULL;
+	return &s_atlas.slots[map[sheetGlyph]-1].texcoord;
+}
+
+bool C2Di_AtlasAdd(u32 sheet, u32 sheetGlyph)
+{
+	u16* map = s_atlas.slotMaps[sheet];
+	if (!map)
+	{
+		TGLP_s* tglp = C2Di_AtlasGlyphInfo();
+		map = s_atlas.slotMaps[sheet] = (u16*)calloc(tglp->nRows*tglp->nLines, sizeof(u16));
+		if (!map)
+			return false;
+	}
+
+	if (map[sheetGlyph])
+	{
+		C2Di_AtlasTouch(map[sheetGlyph]-1);
+		return true;
+	}
+
+	if (!C2Di_AtlasSheetData(sheet))
+		return false;
+
+	// Replace the least recently used glyph, unless it may still be read by the GPU
+	u32 slot = s_atlas.tail;
+	C2Di_AtlasSlot* s = &s_atlas.slots[slot];
+	if (s->sheet != C2Di_ATLAS_FREE)
+	{
+		C2Di_Context* ctx = C2Di_GetContext();
+		if (ctx->frameCount - s->lastUsed < ctx->numFrames)
+			return false;
+		s_atlas.slotMaps[s->sheet][s->sheetGlyph] = 0;
+	}
+
+	C2Di_AtlasStore(slot, sheet, sheetGlyph);
+	map[sheetGlyph] = slot + 1;
+	C2Di_AtlasTouch(slot);
+	return true;
+}
+
+void C2Di_AtlasFlush(void)
+{
+	if (s_atlas.dirty)
+	{
+		C3D_TexFlush(&s_atlas.tex);
+		s_atlas.dirty = false;
+	}
+}
@@ -5,46 +5,71 @@ C2Di_Context __C2Di_Context;
 static C3D_Mtx s_projTop, s_projBot;
 static int uLoc_mdlvMtx, uLoc_projMtx;
 
-static inline bool C2Di_CheckBufSpace(C2Di_Context* ctx, unsigned idx, unsigned vtx)
+static void C2Di_SelectFrameBuf(C2Di_Context* ctx, size_t frame)
 {
-	size_t free_idx = ctx->idxBufSize - ctx->idxBufPos;
-	size_t free_vtx = ctx->vtxBufSize - ctx->vtxBufPos;
-	return free_idx >= idx && free_vtx >= vtx;
+	ctx->curFrame = frame;
+	ctx->vtxBuf = &ctx->vtxBufBase[frame*ctx->vtxBufSize];
+	ctx->idxBuf = &ctx->idxBufBase[frame*ctx->idxBufSize];
+	ctx->vtxBufPos = 0;
+	ctx->idxBufPos = 0;
+	ctx->idxBufLastPos = 0;
+
+	// Indices are relative to the attribute buffer, so rebase it onto this frame's vertices
+	BufInfo_Init(&ctx->bufInfo);
+	BufInfo_Add(&ctx->bufInfo, ctx->vtxBuf, sizeof(C2Di_Vertex), 4, 0x3210);
 }
 
 static void C2Di_FrameEndHook(void* unused)
 {
 	C2Di_Context* ctx = C2Di_GetContext();
 	C2Di_FlushVtxBuf();
-	ctx->vtxBufPos = 0;
-	ctx->idxBufPos = 0;
-	ctx->idxBufLastPos = 0;
+	C2Di_TextArenaFrameEnd();
+	ctx->frameCount++;
+	if (ctx->numFrames > 1)
+	{
+		// Move on to the next slice of the ring so that the GPU can keep reading this one
+		C2Di_SelectFrameBuf(ctx, (ctx->curFrame + 1) % ctx->numFrames);
+		ctx->flags |= C2DiF_DirtyBuf;
+	} else
+	{
+		ctx->vtxBufPos = 0;
+		ctx->idxBufPos = 0;
+		ctx->idxBufLastPos = 0;
+	}
 }
 
 bool C2D_Init(size_t maxObjects)
+{
+	return C2D_InitEx(maxObjects, 1);
+}
+
+bool C2D_InitEx(size_t maxObjects, size_t numFrames)
 {
 	C2Di_Context* ctx = C2Di_GetContext();
 	if (ctx->flags & C2DiF_Active)
 		return false;
+	if (!numFrames)
+		numFrames = 1;
 
+	ctx->numFrames = numFrames;
 	ctx->vtxBufSize = 4*maxObjects;
-	ctx->vtxBuf = (C2Di_Vertex*)linearAlloc(ctx->vtxBufSize*sizeof(C2Di_Vertex));
-	if (!ctx->vtxBuf)
+	ctx->vtxBufBase = (C2Di_Vertex*)linearAlloc(numFrames*ctx->vtxBufSize*sizeof(C2Di_Vertex));
+	if (!ctx->vtxBufBase)
 		return false;
 
 	ctx->idxBufSize = 6*maxObjects;
-	ctx->idxBuf = (u16*)linearAlloc(ctx->idxBufSize*sizeof(u16));
-	if (!ctx->idxBuf)
+	ctx->idxBufBase = (u16*)linearAlloc(numFrames*ctx->idxBufSize*sizeof(u16));
+	if (!ctx->idxBufBase)
 	{
-		linearFree(ctx->vtxBuf);
+		linearFree(ctx->vtxBufBase);
 		return false;
 	}
 
 	ctx->shader = DVLB_ParseFile((u32*)render2d_shbin, render2d_shbin_size);
 	if (!ctx->shader)
 	{
-		linearFree(ctx->idxBuf);
-		linearFree(ctx->vtxBuf);
+		linearFree(ctx->idxBufBase);
+		linearFree(ctx->vtxBufBase);
 		return false;
 	}
 
@@ -57,8 +82,7 @@ bool C2D_Init(size_t maxObjects)
 	AttrInfo_AddLoader(&ctx->attrInfo, 2, GPU_FLOAT,         2); // v2=blend
 	AttrInfo_AddLoader(&ctx->attrInfo, 3, GPU_UNSIGNED_BYTE, 4); // v3=color
 
-	BufInfo_Init(&ctx->bufInfo);
-	BufInfo_Add(&ctx->bufInfo, ctx->vtxBuf, sizeof(C2Di_Vertex), 4, 0x3210);
+	C2Di_SelectFrameBuf(ctx, 0);
 
 	// Cache these common projection matrices
 	Mtx_OrthoTilt(&s_projTop, 0.0f, 400.0f, 240.0f, 0.0f, 1.0f, -1.0f, true);
@@ -91,9 +115,6 @@ bool C2D_Init(size_t maxObjects)
 	ProcTexLut_FromArray(&ctx->ptCircleLut, data);
 
 	ctx->flags = C2DiF_Active | (C2DiF_Mode_ImageSolid << (C2DiF_TintMode_Shift-C2DiF_Mode_Shift));
-	ctx->vtxBufPos = 0;
-	ctx->idxBufPos = 0;
-	ctx->idxBufLastPos = 0;
 	Mtx_Identity(&ctx->projMtx);
 	Mtx_Identity(&ctx->mdlvMtx);
 	ctx->fadeClr = 0;
@@ -112,8 +133,8 @@ void C2D_Fini(void)
 	C3D_FrameEndHook(NULL, NULL);
 	shaderProgramFree(&ctx->program);
 	DVLB_Free(ctx->shader);
-	linearFree(ctx->idxBuf);
-	linearFree(ctx->vtxBuf);
+	linearFree(ctx->idxBufBase);
+	linearFree(ctx->vtxBufBase);
 }
 
 void C2D_Prepare(void)
@@ -122,7 +143,7 @@ void C2D_Prepare(void)
 	if (!(ctx->flags & C2DiF_Active))
 		return;
 
-	ctx->flags  = (ctx->flags &~ (C2DiF_Mode_Mask|C2DiF_ProcTex_Mask)) | C2DiF_DirtyAny;
+	ctx->flags  = (ctx->flags &~ (C2DiF_Mode_Mask|C2DiF_ProcTex_Mask|C2DiF_AlphaTest)) | C2DiF_DirtyAny;
 	ctx->curTex = NULL;
 
 	C3D_BindProgram(&ctx->program);
@@ -153,6 +174,9 @@ void C2D_Prepare(void)
 
 	// Don't cull anything
 	C3D_CullFace(GPU_CULL_NONE);
+
+	// Only distance field text uses the alpha test
+	C3D_AlphaTest(false, GPU_ALWAYS, 0);
 }
 
 void C2D_Flush(void)
@@ -552,6 +576,27 @@ void C2Di_AppendQuad(void)
 	*idx++ = ctx->vtxBufPos+3;
 }
 
+C2Di_Vertex* C2Di_AppendQuads(size_t count)
+{
+	C2Di_Context* ctx = C2Di_GetContext();
+	u16* idx = &ctx->idxBuf[ctx->idxBufPos];
+	u16 base = ctx->vtxBufPos;
+	C2Di_Vertex* vtx = &ctx->vtxBuf[ctx->vtxBufPos];
+	ctx->idxBufPos += 6*count;
+	ctx->vtxBufPos += 4*count;
+
+	for (; count; count --, base += 4)
+	{
+		*idx++ = base+0;
+		*idx++ = base+2;
+		*idx++ = base+1;
+		*idx++ = base+1;
+		*idx++ = base+2;
+		*idx++ = base+3;
+	}
+	return vtx;
+}
+
 void C2Di_AppendVtx(float x, float y, float z, float u, float v, float ptx, float pty, u32 color)
 {
 	C2Di_Context* ctx = C2Di_GetContext();
@@ -591,6 +636,8 @@ void C2Di_Update(void)
 		C3D_TexBind(0, ctx->curTex);
 	if (flags & C2DiF_DirtyFade)
 		C3D_TexEnvColor(C3D_GetTexEnv(5), ctx->fadeClr);
+	if (flags & C2DiF_DirtyBuf)
+		C3D_SetBufInfo(&ctx->bufInfo);
 
 	u32 mode = ctx->flags & C2DiF_Mode_Mask;
 	u32 proctex = C2DiF_ProcTex_None;
@@ -640,6 +687,48 @@ void C2Di_Update(void)
 			break;
 		}
 
+		case C2DiF_Mode_TextSdf:
+		{
+			// The distance field is 0.5 on the outline of the glyph. Turn it into an edge 1/32 of the field wide
+			// (a quarter of a texel with the default spread of sdffont), in three steps since the scale of a stage
+			// is at most 4. Each step keeps 0.5 at 0.5, so that the edge stays within range until the last one:
+			// texenv0.a = 4*(dist - 0.375)
+			// texenv1.a = 4*(texenv0.a - 0.375)
+			// texenv2.a = 2*(texenv1.a - 0.25), i.e. 32*(dist - 0.5) + 0.5
+			// texenv3.a = texenv2.a * vtxcolor.a
+			env = C3D_GetTexEnv(0);
+			C3D_TexEnvInit(env);
+			C3D_TexEnvSrc(env, C3D_RGB, GPU_PRIMARY_COLOR, 0, 0);
+			C3D_TexEnvFunc(env, C3D_RGB, GPU_REPLACE);
+			C3D_TexEnvSrc(env, C3D_Alpha, GPU_TEXTURE0, GPU_CONSTANT, 0);
+			C3D_TexEnvFunc(env, C3D_Alpha, GPU_SUBTRACT);
+			C3D_TexEnvScale(env, C3D_Alpha, GPU_TEVSCALE_4);
+			C3D_TexEnvColor(env, 0x60000000);
+
+			env = C3D_GetTexEnv(1);
+			C3D_TexEnvInit(env);
+			C3D_TexEnvSrc(env, C3D_Both, GPU_PREVIOUS, GPU_CONSTANT, 0);
+			C3D_TexEnvFunc(env, C3D_RGB, GPU_REPLACE);
+			C3D_TexEnvFunc(env, C3D_Alpha, GPU_SUBTRACT);
+			C3D_TexEnvScale(env, C3D_Alpha, GPU_TEVSCALE_4);
+			C3D_TexEnvColor(env, 0x60000000);
+
+			env = C3D_GetTexEnv(2);
+			C3D_TexEnvInit(env);
+			C3D_TexEnvSrc(env, C3D_Both, GPU_PREVIOUS, GPU_CONSTANT, 0);
+			C3D_TexEnvFunc(env, C3D_RGB, GPU_REPLACE);
+			C3D_TexEnvFunc(env, C3D_Alpha, GPU_SUBTRACT);
+			C3D_TexEnvScale(env, C3D_Alpha, GPU_TEVSCALE_2);
+			C3D_TexEnvColor(env, 0x40000000);
+
+			env = C3D_GetTexEnv(3);
+			C3D_TexEnvInit(env);
+			C3D_TexEnvSrc(env, C3D_Both, GPU_PREVIOUS, GPU_PRIMARY_COLOR, 0);
+			C3D_TexEnvFunc(env, C3D_RGB, GPU_REPLACE);
+			C3D_TexEnvFunc(env, C3D_Alpha, GPU_MODULATE);
+			break;
+		}
+
 		case C2DiF_Mode_ImageSolid:
 		{
 			// Use texenv to blend the color source with the solid tint color,
@@ -786,6 +875,14 @@ void C2Di_Update(void)
 		}
 	}
 
+	// Discard the fragments outside of distance field glyphs, so that they don't write depth
+	bool alphaTest = mode == C2DiF_Mode_TextSdf;
+	if ((flags & C2DiF_DirtyMode) && alphaTest != !!(ctx->flags & C2DiF_AlphaTest))
+	{
+		ctx->flags ^= C2DiF_AlphaTest;
+		C3D_AlphaTest(alphaTest, GPU_GREATER, 0);
+	}
+
 	if (proctex && proctex != (ctx->flags & C2DiF_ProcTex_Mask))
 	{
 		ctx->flags = (ctx->flags &~ C2DiF_ProcTex_Mask) | proctex;
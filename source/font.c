@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include "internal.h"
 #include <c2d/font.h>
@@ -13,9 +14,32 @@ C2D_Font C2D_FontLoad(const char* filename)
 	return ret;
 }
 
+static C2Di_GlyphCache s_systemGlyphCache;
+static C2D_Font s_sharedFonts;
+
+struct C2Di_FontStream_s
+{
+	FILE* file;
+	u32 sheetOffset; // File offset of the first glyph sheet
+	size_t budget;   // Linear memory the resident sheets may use, 0 for no limit
+	size_t resident; // Linear memory used by the resident sheets
+	u32 lastUsed[0]; // Per sheet, frame it was last used in
+};
+
 static inline C2D_Font C2Di_FontAlloc(void)
 {
-	return (C2D_Font)malloc(sizeof(struct C2D_Font_s));
+	C2D_Font font = (C2D_Font)malloc(sizeof(struct C2D_Font_s));
+	if (font)
+	{
+		memset(&font->glyphCache, 0, sizeof(C2Di_GlyphCache));
+		font->stream = NULL;
+		font->borrowed = false;
+		font->distanceField = false;
+		font->refCount = 1;
+		font->sharedKey = NULL;
+		font->nextShared = NULL;
+	}
+	return font;
 }
 
 static C2D_Font C2Di_PostLoadFont(C2D_Font font)
@@ -29,6 +53,8 @@ static C2D_Font C2Di_PostLoadFont(C2D_Font font)
 		fontFixPointers(font->cfnt);
 
 		TGLP_s* glyphInfo = font->cfnt->finf.tglp;
+		if (font->stream)
+			glyphInfo->sheetData = NULL; // Not part of the resident data, see C2Di_FontLoadSheet
 		font->glyphSheets = malloc(sizeof(C3D_Tex)*glyphInfo->nSheets);
 		font->textScale = 30.0f / glyphInfo->cellHeight;
 		if (!font->glyphSheets)
@@ -41,7 +67,7 @@ static C2D_Font C2Di_PostLoadFont(C2D_Font font)
 		for (i = 0; i < glyphInfo->nSheets; i++)
 		{
 			C3D_Tex* tex = &font->glyphSheets[i];
-			tex->data = &glyphInfo->sheetData[glyphInfo->sheetSize*i];
+			tex->data = glyphInfo->sheetData ? &glyphInfo->sheetData[glyphInfo->sheetSize*i] : NULL;
 			tex->fmt = glyphInfo->sheetFmt;
 			tex->size = glyphInfo->sheetSize;
 			tex->width = glyphInfo->sheetWidth;
@@ -68,6 +94,35 @@ C2D_Font C2D_FontLoadFromMem(const void* data, size_t size)
 	return font;
 }
 
+static C2D_Font C2Di_FontFromMem(void* data, size_t size, bool borrow)
+{
+	CFNT_s* cfnt = (CFNT_s*)data;
+	if (!data || size < sizeof(CFNT_s) || cfnt->fileSize > size)
+		return NULL;
+
+	C2D_Font font = C2Di_FontAlloc();
+	if (font)
+	{
+		// The data stays with the caller until the font is successfully created
+		font->cfnt = cfnt;
+		font->borrowed = true;
+		font = C2Di_PostLoadFont(font);
+		if (font)
+			font->borrowed = borrow;
+	}
+	return font;
+}
+
+C2D_Font C2D_FontAdoptMem(void* data, size_t size)
+{
+	return C2Di_FontFromMem(data, size, false);
+}
+
+C2D_Font C2D_FontBorrowMem(void* data, size_t size)
+{
+	return C2Di_FontFromMem(data, size, true);
+}
+
 C2D_Font C2D_FontLoadFromFD(int fd)
 {
 	C2D_Font font = C2Di_FontAlloc();
@@ -104,51 +159,255 @@ C2D_Font C2D_FontLoadFromHandle(FILE* handle)
 	return font;
 }
 
-static C2D_Font C2Di_FontLoadFromArchive(u64 tid, const char* path)
+// Offsets past the glyph sheets move down by the size of the sheets, since those are left out of the resident data
+static inline uintptr_t C2Di_SkipSheets(uintptr_t offset, u32 sheetOffset, u32 sheetBytes)
 {
-	void* fontLzData = NULL;
-	u32 fontLzSize = 0;
+	return offset >= sheetOffset ? offset - sheetBytes : offset;
+}
 
-	Result rc = romfsMountFromTitle(tid, MEDIATYPE_NAND, "font");
-	if (R_FAILED(rc))
-		return NULL;
+C2D_Font C2D_FontLoadStreamed(const char* filename, size_t sheetBudget)
+{
+	FILE* f = fopen(filename, "rb");
+	if (!f) return NULL;
 
-	FILE* f = fopen(path, "rb");
-	if (f)
+	C2D_Font font = C2Di_FontAlloc();
+	if (!font)
 	{
-		fseek(f, 0, SEEK_END);
-		fontLzSize = ftell(f);
-		rewind(f);
-
-		fontLzData = malloc(fontLzSize);
-		if (fontLzData)
-			fread(fontLzData, 1, fontLzSize, f);
-
 		fclose(f);
+		return NULL;
 	}
 
-	romfsUnmount("font");
+	CFNT_s cfnt;
+	TGLP_s tglp;
+	font->cfnt = NULL;
+	if (fread(&cfnt, 1, sizeof(CFNT_s), f) != sizeof(CFNT_s)
+		|| fseek(f, (uintptr_t)cfnt.finf.tglp, SEEK_SET) != 0
+		|| fread(&tglp, 1, sizeof(TGLP_s), f) != sizeof(TGLP_s))
+		goto _fail;
 
-	if (!fontLzData)
-		return NULL;
+	// Read everything but the glyph sheets, which are stored back to back
+	u32 sheetOffset = (uintptr_t)tglp.sheetData;
+	u32 sheetBytes  = tglp.sheetSize*tglp.nSheets;
+	if (sheetOffset < sizeof(CFNT_s) || sheetOffset > cfnt.fileSize || sheetBytes > cfnt.fileSize - sheetOffset)
+		goto _fail;
+	u32 restBytes = cfnt.fileSize - sheetOffset - sheetBytes;
 
-	C2D_Font font = C2Di_FontAlloc();
+	font->stream = (C2Di_FontStream*)malloc(sizeof(C2Di_FontStream) + tglp.nSheets*sizeof(u32));
+	font->cfnt   = (CFNT_s*)malloc(cfnt.fileSize - sheetBytes);
+	if (!font->stream || !font->cfnt)
+		goto _fail;
+
+	u8* base = (u8*)font->cfnt;
+	rewind(f);
+	if (fread(base, 1, sheetOffset, f) != sheetOffset
+		|| fseek(f, sheetBytes, SEEK_CUR) != 0
+		|| fread(base + sheetOffset, 1, restBytes, f) != restBytes)
+		goto _fail;
+
+	// Rebase the offsets that fontFixPointers turns into pointers
+	FINF_s* finf = &font->cfnt->finf;
+	finf->tglp = (TGLP_s*)C2Di_SkipSheets((uintptr_t)finf->tglp, sheetOffset, sheetBytes);
+	CWDH_s** cwdh;
+	for (cwdh = &finf->cwdh; *cwdh; cwdh = &((CWDH_s*)(base + (uintptr_t)*cwdh))->next)
+		*cwdh = (CWDH_s*)C2Di_SkipSheets((uintptr_t)*cwdh, sheetOffset, sheetBytes);
+	CMAP_s** cmap;
+	for (cmap = &finf->cmap; *cmap; cmap = &((CMAP_s*)(base + (uintptr_t)*cmap))->next)
+		*cmap = (CMAP_s*)C2Di_SkipSheets((uintptr_t)*cmap, sheetOffset, sheetBytes);
+
+	font->stream->file        = f;
+	font->stream->sheetOffset = sheetOffset;
+	font->stream->budget      = sheetBudget;
+	font->stream->resident    = 0;
+	return C2Di_PostLoadFont(font);
+
+_fail:
+	fclose(f);
+	free(font->stream);
+	free(font->cfnt);
+	free(font);
+	return NULL;
+}
+
+static void* C2Di_FontLoadJob(const char* filename)
+{
+	return C2D_FontLoad(filename);
+}
+
+static void* C2Di_FontFinishJob(void* result)
+{
+	// The glyph sheets were written on the worker thread, make sure the GPU sees them
+	C2D_Font font = (C2D_Font)result;
+	int i;
+	for (i = 0; i < font->cfnt->finf.tglp->nSheets; i ++)
+		C3D_TexFlush(&font->glyphSheets[i]);
+	return font;
+}
+
+static void C2Di_FontDiscardJob(void* result)
+{
+	C2D_FontFree((C2D_Font)result);
+}
+
+const C2Di_LoadOps C2Di_FontLoadOps =
+{
+	C2Di_FontLoadJob,
+	C2Di_FontFinishJob,
+	C2Di_FontDiscardJob,
+};
+
+static C2D_Font C2Di_FontFindShared(const char* key)
+{
+	C2D_Font font;
+	for (font = s_sharedFonts; font; font = font->nextShared)
+		if (strcmp(font->sharedKey, key) == 0)
+		{
+			font->refCount++;
+			return font;
+		}
+	return NULL;
+}
+
+static C2D_Font C2Di_FontShare(C2D_Font font, const char* key)
+{
+	// If the key can't be stored, the font simply isn't shared
+	if (font && (font->sharedKey = strdup(key)))
+	{
+		font->nextShared = s_sharedFonts;
+		s_sharedFonts = font;
+	}
+	return font;
+}
+
+C2D_Font C2D_FontLoadShared(const char* filename)
+{
+	C2D_Font font = C2Di_FontFindShared(filename);
 	if (!font)
+		font = C2Di_FontShare(C2D_FontLoad(filename), filename);
+	return font;
+}
+
+#define C2Di_LZ11_CHUNK 0x1000
+
+typedef struct
+{
+	FILE* file;
+	size_t pos, size;
+	u8 buf[C2Di_LZ11_CHUNK];
+} C2Di_LzReader;
+
+static inline bool C2Di_LzRead(C2Di_LzReader* r, u8* out)
+{
+	if (r->pos == r->size)
 	{
-		free(fontLzData);
-		return NULL;
+		r->size = fread(r->buf, 1, sizeof(r->buf), r->file);
+		r->pos  = 0;
+		if (!r->size)
+			return false;
 	}
+	*out = r->buf[r->pos++];
+	return true;
+}
 
-	u32 fontSize = *(u32*)fontLzData >> 8;
-	font->cfnt = linearAlloc(fontSize);
-	if (font->cfnt && !decompress_LZ11(font->cfnt, fontSize, NULL, (u8*)fontLzData + 4, fontLzSize - 4))
+// Decompresses LZ11 data straight into its final buffer, reading the compressed data in small chunks.
+// Back references only ever point into the output, so no separate window is needed.
+bool C2Di_DecompressLZ11(FILE* f, u8* out, size_t size)
+{
+	C2Di_LzReader r;
+	r.file = f;
+	r.pos  = 0;
+	r.size = 0;
+
+	size_t pos = 0;
+	u8 flags = 0, mask = 0, b[4];
+	while (pos < size)
 	{
-		linearFree(font->cfnt);
-		font->cfnt = NULL;
+		// Each flag byte tells whether the next 8 blocks are literals or back references, MSB first
+		if (!mask)
+		{
+			if (!C2Di_LzRead(&r, &flags))
+				return false;
+			mask = 0x80;
+		}
+		bool ref = flags & mask;
+		mask >>= 1;
+
+		if (!ref)
+		{
+			if (!C2Di_LzRead(&r, &out[pos++]))
+				return false;
+			continue;
+		}
+
+		size_t len, disp;
+		if (!C2Di_LzRead(&r, &b[0]) || !C2Di_LzRead(&r, &b[1]))
+			return false;
+		switch (b[0] >> 4)
+		{
+			case 0:
+				if (!C2Di_LzRead(&r, &b[2]))
+					return false;
+				len  = (((b[0] & 0xF) << 4) | (b[1] >> 4)) + 0x11;
+				disp = ((b[1] & 0xF) << 8) | b[2];
+				break;
+			case 1:
+				if (!C2Di_LzRead(&r, &b[2]) || !C2Di_LzRead(&r, &b[3]))
+					return false;
+				len  = (((b[0] & 0xF) << 12) | (b[1] << 4) | (b[2] >> 4)) + 0x111;
+				disp = ((b[2] & 0xF) << 8) | b[3];
+				break;
+			default:
+				len  = (b[0] >> 4) + 1;
+				disp = ((b[0] & 0xF) << 8) | b[1];
+				break;
+		}
+		disp++;
+
+		if (disp > pos || len > size - pos)
+			return false;
+		// Byte by byte, since the source and destination may overlap
+		const u8* src = &out[pos - disp];
+		while (len--)
+			out[pos++] = *src++;
 	}
-	free(fontLzData);
+	return true;
+}
 
-	return C2Di_PostLoadFont(font);
+static C2D_Font C2Di_FontLoadFromArchive(u64 tid, const char* path)
+{
+	Result rc = romfsMountFromTitle(tid, MEDIATYPE_NAND, "font");
+	if (R_FAILED(rc))
+		return NULL;
+
+	C2D_Font font = NULL;
+	FILE* f = fopen(path, "rb");
+	if (f)
+	{
+		font = C2Di_FontAlloc();
+		if (font)
+		{
+			// Decompress straight from the file, so that the compressed font is never fully in memory
+			font->cfnt = NULL;
+			u32 header, fontSize = 0;
+			if (fread(&header, 1, sizeof(header), f) == sizeof(header) && (header & 0xFF) == 0x11)
+			{
+				fontSize = header >> 8;
+				if (!fontSize && fread(&fontSize, 1, sizeof(fontSize), f) != sizeof(fontSize))
+					fontSize = 0;
+			}
+			if (fontSize)
+				font->cfnt = linearAlloc(fontSize);
+			if (font->cfnt && !C2Di_DecompressLZ11(f, (u8*)font->cfnt, fontSize))
+			{
+				linearFree(font->cfnt);
+				font->cfnt = NULL;
+			}
+			font = C2Di_PostLoadFont(font);
+		}
+		fclose(f);
+	}
+
+	romfsUnmount("font");
+	return font;
 }
 
 static unsigned C2Di_RegionToFontIndex(CFG_Region region)
@@ -190,18 +449,117 @@ C2D_Font C2D_FontLoadSystem(CFG_Region region)
 		return NULL;
 	}
 
+	// Reuse the font if it's already loaded, the archive paths serve as keys
+	C2D_Font font = C2Di_FontFindShared(C2Di_FontPaths[fontIdx]);
+	if (font)
+		return font;
+
 	// Load the font
-	return C2Di_FontLoadFromArchive(0x0004009b00014002ULL | (fontIdx<<8), C2Di_FontPaths[fontIdx]);
+	font = C2Di_FontLoadFromArchive(0x0004009b00014002ULL | (fontIdx<<8), C2Di_FontPaths[fontIdx]);
+	return C2Di_FontShare(font, C2Di_FontPaths[fontIdx]);
 }
 
 void C2D_FontFree(C2D_Font font)
 {
-	if (font)
+	if (font && --font->refCount == 0)
 	{
-		if (font->cfnt)
+		if (font->sharedKey)
+		{
+			C2D_Font* link = &s_sharedFonts;
+			while (*link != font)
+				link = &(*link)->nextShared;
+			*link = font->nextShared;
+			free(font->sharedKey);
+		}
+
+		int i;
+		free(font->glyphCache.direct);
+		free(font->glyphCache.hash);
+		if (font->glyphCache.sheetTexcoords)
+		{
+			for (i = 0; i < font->cfnt->finf.tglp->nSheets; i ++)
+				free(font->glyphCache.sheetTexcoords[i]);
+			free(font->glyphCache.sheetTexcoords);
+		}
+		if (font->stream)
+		{
+			// Only the resident sheets are in linear memory
+			if (font->glyphSheets)
+				for (i = 0; i < font->cfnt->finf.tglp->nSheets; i ++)
+					if (font->glyphSheets[i].data)
+						linearFree(font->glyphSheets[i].data);
+			fclose(font->stream->file);
+			free(font->stream);
+			free(font->cfnt);
+		} else if (font->cfnt && !font->borrowed)
 			linearFree(font->cfnt);
 		free(font->glyphSheets);
+		free(font);
+	}
+}
+
+// Frees the least recently used sheet that the GPU is done with, returns false if there is none
+static bool C2Di_FontEvictSheet(C2D_Font font)
+{
+	C2Di_Context* ctx = C2Di_GetContext();
+	C2Di_FontStream* stream = font->stream;
+	TGLP_s* glyphInfo = font->cfnt->finf.tglp;
+	u32 oldest = 0;
+	int i, sheet = -1;
+	for (i = 0; i < glyphInfo->nSheets; i ++)
+	{
+		u32 age = ctx->frameCount - stream->lastUsed[i];
+		if (font->glyphSheets[i].data && age >= ctx->numFrames && (sheet < 0 || age > oldest))
+		{
+			sheet  = i;
+			oldest = age;
+		}
 	}
+	if (sheet < 0)
+		return false;
+
+	// The texture keeps its address when the sheet is reloaded, make sure it gets bound again by then
+	if (ctx->curTex == &font->glyphSheets[sheet])
+		ctx->curTex = NULL;
+	linearFree(font->glyphSheets[sheet].data);
+	font->glyphSheets[sheet].data = NULL;
+	stream->resident -= glyphInfo->sheetSize;
+	return true;
+}
+
+bool C2Di_FontLoadSheet(C2D_Font font, u32 sheet)
+{
+	C2Di_Context* ctx = C2Di_GetContext();
+	C2Di_FontStream* stream = font->stream;
+	C3D_Tex* tex = &font->glyphSheets[sheet];
+	stream->lastUsed[sheet] = ctx->frameCount;
+	if (tex->data)
+		return true;
+
+	// Stay within the budget if possible, sheets that are still in use are never evicted though
+	TGLP_s* glyphInfo = font->cfnt->finf.tglp;
+	while (stream->budget && stream->resident + glyphInfo->sheetSize > stream->budget)
+		if (!C2Di_FontEvictSheet(font))
+			break;
+
+	void* data;
+	while (!(data = linearAlloc(glyphInfo->sheetSize)))
+		if (!C2Di_FontEvictSheet(font))
+			return false;
+
+	if (fseek(stream->file, stream->sheetOffset + sheet*glyphInfo->sheetSize, SEEK_SET) != 0
+		|| fread(data, 1, glyphInfo->sheetSize, stream->file) != glyphInfo->sheetSize)
+	{
+		linearFree(data);
+		return false;
+	}
+
+	tex->data = data;
+	stream->resident += glyphInfo->sheetSize;
+	C3D_TexFlush(tex);
+	if (ctx->curTex == tex)
+		ctx->flags |= C2DiF_DirtyTex; // Bound with its old data
+	return true;
 }
 
 void C2D_FontSetFilter(C2D_Font font, GPU_TEXTURE_FILTER_PARAM magFilter, GPU_TEXTURE_FILTER_PARAM minFilter)
@@ -219,6 +577,12 @@ void C2D_FontSetFilter(C2D_Font font, GPU_TEXTURE_FILTER_PARAM magFilter, GPU_TE
 	}
 }
 
+void C2D_FontSetDistanceField(C2D_Font font, bool enable)
+{
+	if (font)
+		font->distanceField = enable;
+}
+
 int C2D_FontGlyphIndexFromCodePoint(C2D_Font font, u32 codepoint)
 {
 	if (!font)
@@ -250,3 +614,201 @@ FINF_s* C2D_FontGetInfo(C2D_Font font)
 	else
 		return fontGetInfo(font->cfnt);
 }
+
+static inline u32 C2Di_GlyphsPerSheet(C2D_Font font)
+{
+	TGLP_s* tglp = C2D_FontGetInfo(font)->tglp;
+	return tglp->nRows*tglp->nLines;
+}
+
+void C2Di_FontFillGlyphInfo(C2D_Font font, C2Di_GlyphInfo* info, u32 code)
+{
+	fontGlyphPos_s glyphData;
+	int glyphIndex = C2D_FontGlyphIndexFromCodePoint(font, code);
+	C2D_FontCalcGlyphPos(font, &glyphData, glyphIndex, 0, 1.0f, 1.0f);
+
+	info->code       = code;
+	info->sheetIndex = glyphData.sheetIndex;
+	info->sheetGlyph = glyphIndex - glyphData.sheetIndex*C2Di_GlyphsPerSheet(font);
+	info->xOffset    = glyphData.xOffset;
+	info->xAdvance   = glyphData.xAdvance;
+	info->width      = glyphData.width;
+}
+
+void C2Di_FontCalcTexcoord(C2D_Font font, u32 sheet, u32 sheetGlyph, C2Di_Texcoord* out)
+{
+	fontGlyphPos_s glyphData;
+	C2D_FontCalcGlyphPos(font, &glyphData, sheet*C2Di_GlyphsPerSheet(font) + sheetGlyph, 0, 1.0f, 1.0f);
+
+	out->left   = glyphData.texcoord.left;
+	out->top    = glyphData.texcoord.top;
+	out->right  = glyphData.texcoord.right;
+	out->bottom = glyphData.texcoord.bottom;
+}
+
+const C2Di_Texcoord* C2Di_FontGetSheetTexcoords(C2D_Font font, u32 sheet)
+{
+	C2Di_GlyphCache* cache = font ? &font->glyphCache : &s_systemGlyphCache;
+	if (!cache->sheetTexcoords)
+	{
+		cache->sheetTexcoords = (C2Di_Texcoord**)calloc(C2D_FontGetInfo(font)->tglp->nSheets, sizeof(C2Di_Texcoord*));
+		if (!cache->sheetTexcoords)
+			return NULL;
+	}
+
+	C2Di_Texcoord* texcoords = cache->sheetTexcoords[sheet];
+	if (!texcoords)
+	{
+		// Calculate the whole sheet at once, it is only ever done the first time it's drawn from
+		u32 i, perSheet = C2Di_GlyphsPerSheet(font);
+		texcoords = (C2Di_Texcoord*)malloc(perSheet*sizeof(C2Di_Texcoord));
+		if (!texcoords)
+			return NULL;
+		for (i = 0; i < perSheet; i ++)
+			C2Di_FontCalcTexcoord(font, sheet, i, &texcoords[i]);
+		cache->sheetTexcoords[sheet] = texcoords;
+	}
+	return texcoords;
+}
+
+static inline size_t C2Di_GlyphCacheHash(u32 code, size_t size)
+{
+	return (code*2654435761U) & (size-1);
+}
+
+static bool C2Di_GlyphCacheGrow(C2Di_GlyphCache* cache)
+{
+	size_t newSize = cache->hashSize ? 2*cache->hashSize : 256;
+	C2Di_GlyphInfo* newHash = (C2Di_GlyphInfo*)malloc(newSize*sizeof(C2Di_GlyphInfo));
+	if (!newHash)
+		return false;
+
+	size_t i;
+	for (i = 0; i < newSize; i ++)
+		newHash[i].code = C2Di_GLYPHCACHE_EMPTY;
+
+	// Rehash existing entries
+	for (i = 0; i < cache->hashSize; i ++)
+	{
+		C2Di_GlyphInfo* info = &cache->hash[i];
+		if (info->code == C2Di_GLYPHCACHE_EMPTY)
+			continue;
+		size_t pos = C2Di_GlyphCacheHash(info->code, newSize);
+		while (newHash[pos].code != C2Di_GLYPHCACHE_EMPTY)
+			pos = (pos+1) & (newSize-1);
+		newHash[pos] = *info;
+	}
+
+	free(cache->hash);
+	cache->hash = newHash;
+	cache->hashSize = newSize;
+	return true;
+}
+
+const C2Di_GlyphInfo* C2Di_FontGetGlyphInfo(C2D_Font font, u32 code)
+{
+	static C2Di_GlyphInfo s_uncached;
+	C2Di_GlyphCache* cache = font ? &font->glyphCache : &s_systemGlyphCache;
+	C2Di_GlyphInfo* info;
+
+	if (code < C2Di_GLYPHCACHE_DIRECT)
+	{
+		if (!cache->direct)
+		{
+			cache->direct = (C2Di_GlyphInfo*)malloc(C2Di_GLYPHCACHE_DIRECT*sizeof(C2Di_GlyphInfo));
+			if (!cache->direct)
+				goto _uncached;
+
+			int i;
+			for (i = 0; i < C2Di_GLYPHCACHE_DIRECT; i ++)
+				cache->direct[i].code = C2Di_GLYPHCACHE_EMPTY;
+		}
+
+		info = &cache->direct[code];
+		if (info->code != code)
+			C2Di_FontFillGlyphInfo(font, info, code);
+		return info;
+	}
+
+	if (cache->hashSize)
+	{
+		size_t pos = C2Di_GlyphCacheHash(code, cache->hashSize);
+		for (;;)
+		{
+			info = &cache->hash[pos];
+			if (info->code == code)
+				return info;
+			if (info->code == C2Di_GLYPHCACHE_EMPTY)
+				break;
+			pos = (pos+1) & (cache->hashSize-1);
+		}
+	}
+
+	// Keep the load factor at or below 3/4
+	if (4*(cache->hashCount+1) > 3*cache->hashSize)
+	{
+		if (!C2Di_GlyphCacheGrow(cache))
+			goto _uncached;
+	}
+
+	size_t pos = C2Di_GlyphCacheHash(code, cache->hashSize);
+	while (cache->hash[pos].code != C2Di_GLYPHCACHE_EMPTY)
+		pos = (pos+1) & (cache->hashSize-1);
+	info = &cache->hash[pos];
+	cache->hashCount++;
+	C2Di_FontFillGlyphInfo(font, info, code);
+	return info;
+
+_uncached:
+	C2Di_FontFillGlyphInfo(font, &s_uncached, code);
+	return &s_uncached;
+}
+
+// Read-only version of C2Di_FontGetGlyphInfo, which can be called from several threads at once as long as
+// nothing is added to the cache meanwhile. Returns NULL if the glyph isn't cached.
+const C2Di_GlyphInfo* C2Di_FontPeekGlyphInfo(C2D_Font font, u32 code)
+{
+	const C2Di_GlyphCache* cache = font ? &font->glyphCache : &s_systemGlyphCache;
+	if (code < C2Di_GLYPHCACHE_DIRECT)
+		return cache->direct && cache->direct[code].code == code ? &cache->direct[code] : NULL;
+
+	if (cache->hashSize)
+	{
+		size_t pos = C2Di_GlyphCacheHash(code, cache->hashSize);
+		for (;;)
+		{
+			const C2Di_GlyphInfo* info = &cache->hash[pos];
+			if (info->code == code)
+				return info;
+			if (info->code == C2Di_GLYPHCACHE_EMPTY)
+				break;
+			pos = (pos+1) & (cache->hashSize-1);
+		}
+	}
+	return NULL;
+}
+
+// Caches every codepoint of the directly indexed part, so that C2Di_FontPeekGlyphInfo finds all of them
+void C2Di_FontFillDirectCache(C2D_Font font)
+{
+	u32 code;
+	for (code = 0; code < C2Di_GLYPHCACHE_DIRECT; code ++)
+		C2Di_FontGetGlyphInfo(font, code);
+}
+
+float C2Di_FontGetDigitAdvance(C2D_Font font)
+{
+	C2Di_GlyphCache* cache = font ? &font->glyphCache : &s_systemGlyphCache;
+	if (cache->digitAdvance == 0.0f)
+	{
+		// Only calculated once, the digits themselves are looked up in the directly indexed part of the cache
+		u32 code;
+		for (code = '0'; code <= '9'; code ++)
+		{
+			float xAdvance = C2Di_FontGetGlyphInfo(font, code)->xAdvance;
+			if (xAdvance > cache->digitAdvance)
+				cache->digitAdvance = xAdvance;
+		}
+	}
+	return cache->digitAdvance;
+}
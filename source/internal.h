@@ -1,5 +1,6 @@
 #pragma once
 #include <c2d/base.h>
+#include <c2d/font.h>
 
 typedef struct
 {
@@ -21,6 +22,12 @@ typedef struct
 	C3D_ProcTexLut ptCircleLut;
 	u32 sceneW, sceneH;
 
+	C2Di_Vertex* vtxBufBase;
+	u16* idxBufBase;
+	size_t numFrames;
+	size_t curFrame;
+	u32 frameCount; // Number of frames ended so far
+
 	C2Di_Vertex* vtxBuf;
 	u16* idxBuf;
 
@@ -46,6 +53,8 @@ enum
 	C2DiF_DirtyTex     = BIT(3),
 	C2DiF_DirtyMode    = BIT(4),
 	C2DiF_DirtyFade    = BIT(5),
+	C2DiF_DirtyBuf     = BIT(6),
+	C2DiF_AlphaTest    = BIT(7),
 
 	C2DiF_Mode_Shift      = 8,
 	C2DiF_Mode_Mask       = 0xf << C2DiF_Mode_Shift,
@@ -59,6 +68,7 @@ enum
 	C2DiF_Mode_ImageSub   = 7   << C2DiF_Mode_Shift,
 	C2DiF_Mode_ImageOMAdd = 8   << C2DiF_Mode_Shift,
 	C2DiF_Mode_ImageOMSub = 9   << C2DiF_Mode_Shift,
+	C2DiF_Mode_TextSdf    = 10  << C2DiF_Mode_Shift,
 
 	C2DiF_ProcTex_Shift  = 12,
 	C2DiF_ProcTex_Mask   = 0xf << C2DiF_ProcTex_Shift,
@@ -69,14 +79,51 @@ enum
 	C2DiF_TintMode_Shift = 16,
 	C2DiF_TintMode_Mask  = 0xf << C2DiF_TintMode_Shift,
 
-	C2DiF_DirtyAny = C2DiF_DirtyProj | C2DiF_DirtyMdlv | C2DiF_DirtyTex | C2DiF_DirtyMode | C2DiF_DirtyFade,
+	C2DiF_DirtyAny = C2DiF_DirtyProj | C2DiF_DirtyMdlv | C2DiF_DirtyTex | C2DiF_DirtyMode | C2DiF_DirtyFade | C2DiF_DirtyBuf,
 };
 
+typedef struct
+{
+	u32 code;
+	u16 sheetIndex;
+	u16 sheetGlyph; // Index of the glyph within its sheet
+	float xOffset;
+	float xAdvance;
+	float width;
+} C2Di_GlyphInfo;
+
+typedef struct
+{
+	float left, top, right, bottom;
+} C2Di_Texcoord;
+
+#define C2Di_GLYPHCACHE_DIRECT 0x100
+#define C2Di_GLYPHCACHE_EMPTY  UINT32_MAX
+
+typedef struct
+{
+	C2Di_GlyphInfo* direct; // Codepoints below C2Di_GLYPHCACHE_DIRECT, indexed directly
+	C2Di_GlyphInfo* hash;   // Everything else, open addressing with linear probing
+	size_t hashSize;
+	size_t hashCount;
+	C2Di_Texcoord** sheetTexcoords; // Per sheet, filled in on first use
+	float digitAdvance; // Widest advance among the digits, 0 until first needed
+} C2Di_GlyphCache;
+
+typedef struct C2Di_FontStream_s C2Di_FontStream;
+
 struct C2D_Font_s
 {
 	CFNT_s* cfnt;
 	C3D_Tex* glyphSheets;
 	float textScale;
+	C2Di_GlyphCache glyphCache;
+	C2Di_FontStream* stream; // Only set if the glyph sheets are loaded on demand
+	bool borrowed; // The font data belongs to the caller, see C2D_FontBorrowMem
+	bool distanceField; // The glyph sheets hold signed distance fields
+	u32 refCount;
+	char* sharedKey; // Set if the font is in the shared font list
+	C2D_Font nextShared;
 };
 
 static inline C2Di_Context* C2Di_GetContext(void)
@@ -85,6 +132,13 @@ static inline C2Di_Context* C2Di_GetContext(void)
 	return &__C2Di_Context;
 }
 
+static inline bool C2Di_CheckBufSpace(C2Di_Context* ctx, unsigned idx, unsigned vtx)
+{
+	size_t free_idx = ctx->idxBufSize - ctx->idxBufPos;
+	size_t free_vtx = ctx->vtxBufSize - ctx->vtxBufPos;
+	return free_idx >= idx && free_vtx >= vtx;
+}
+
 static inline void C2Di_SetMode(u32 mode)
 {
 	C2Di_Context* ctx = C2Di_GetContext();
@@ -114,6 +168,35 @@ typedef struct
 void C2Di_CalcQuad(C2Di_Quad* quad, const C2D_DrawParams* params);
 void C2Di_AppendTri(void);
 void C2Di_AppendQuad(void);
+C2Di_Vertex* C2Di_AppendQuads(size_t count);
 void C2Di_AppendVtx(float x, float y, float z, float u, float v, float ptx, float pty, u32 color);
 void C2Di_FlushVtxBuf(void);
 void C2Di_Update(void);
+
+void C2Di_TextArenaFrameEnd(void);
+
+typedef struct
+{
+	void* (*load)(const char* filename); // Runs on the worker thread
+	void* (*finish)(void* result);       // Runs on the thread that draws, once loading succeeded
+	void (*discard)(void* result);       // Frees the result of a cancelled job
+} C2Di_LoadOps;
+
+extern const C2Di_LoadOps C2Di_FontLoadOps;
+extern const C2Di_LoadOps C2Di_SpriteSheetLoadOps;
+
+const C2Di_GlyphInfo* C2Di_FontGetGlyphInfo(C2D_Font font, u32 code);
+const C2Di_GlyphInfo* C2Di_FontPeekGlyphInfo(C2D_Font font, u32 code);
+void C2Di_FontFillGlyphInfo(C2D_Font font, C2Di_GlyphInfo* info, u32 code);
+void C2Di_FontFillDirectCache(C2D_Font font);
+const C2Di_Texcoord* C2Di_FontGetSheetTexcoords(C2D_Font font, u32 sheet);
+void C2Di_FontCalcTexcoord(C2D_Font font, u32 sheet, u32 sheetGlyph, C2Di_Texcoord* out);
+float C2Di_FontGetDigitAdvance(C2D_Font font);
+bool C2Di_FontLoadSheet(C2D_Font font, u32 sheet);
+bool C2Di_DecompressLZ11(FILE* f, u8* out, size_t size);
+
+bool C2Di_AtlasHasFont(C2D_Font font);
+C3D_Tex* C2Di_AtlasGetTex(void);
+const C2Di_Texcoord* C2Di_AtlasFind(u32 sheet, u32 sheetGlyph);
+bool C2Di_AtlasAdd(u32 sheet, u32 sheetGlyph);
+void C2Di_AtlasFlush(void);
@@ -39,6 +39,44 @@ static inline C2D_SpriteSheet C2Di_PostLoadSheet(C2D_SpriteSheet sheet)
 	return sheet;
 }
 
+static void* C2Di_SpriteSheetLoadJob(const char* filename)
+{
+	FILE* f = fopen(filename, "rb");
+	if (!f) return NULL;
+	setvbuf(f, NULL, _IOFBF, 64*1024);
+
+	// Only import the texture here, it is set up for drawing by C2Di_SpriteSheetFinishJob
+	C2D_SpriteSheet sheet = C2Di_SpriteSheetAlloc();
+	if (sheet)
+	{
+		sheet->t3x = Tex3DS_TextureImportStdio(f, &sheet->tex, NULL, false);
+		if (!sheet->t3x)
+		{
+			free(sheet);
+			sheet = NULL;
+		}
+	}
+	fclose(f);
+	return sheet;
+}
+
+static void* C2Di_SpriteSheetFinishJob(void* result)
+{
+	return C2Di_PostLoadSheet((C2D_SpriteSheet)result);
+}
+
+static void C2Di_SpriteSheetDiscardJob(void* result)
+{
+	C2D_SpriteSheetFree((C2D_SpriteSheet)result);
+}
+
+const C2Di_LoadOps C2Di_SpriteSheetLoadOps =
+{
+	C2Di_SpriteSheetLoadJob,
+	C2Di_SpriteSheetFinishJob,
+	C2Di_SpriteSheetDiscardJob,
+};
+
 C2D_SpriteSheet C2D_SpriteSheetLoadFromMem(const void* data, size_t size)
 {
 	C2D_SpriteSheet sheet = C2Di_SpriteSheetAlloc();
@@ -3,31 +3,95 @@
 #include <c2d/text.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdio.h>
+#ifndef __3DS__
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 static C3D_Tex* s_glyphSheets;
 static float s_textScale;
 
+// Texture coordinates aren't stored, they are looked up from the font when drawing
 typedef struct C2Di_Glyph_s
 {
-	u32 lineNo;
-	C3D_Tex* sheet;
-	float xPos;
-	float width;
-	struct
-	{
-		float left, top, right, bottom;
-	} texcoord;
-	u32 wordNo;
+	float xPos;     // In font units
+	u16 sheet;
+	u16 sheetGlyph; // Index of the glyph within its sheet
+	u16 lineNo;
+	u16 wordNo;
+	u8 width;       // In font units (glyph widths are whole pixels, at most 255)
+	u8 flags;       // C2Di_GLYPH_* flags of the text object, set on its first glyph
+	u16 color;      // Set by color markup: index+1 in the color table of the buffer, 0 for the color passed when drawing
 } C2Di_Glyph;
 
+#define C2Di_GLYPH_REORDERED BIT(0) // The glyphs are no longer in line order (see C2D_TextOptimize)
+#define C2Di_GLYPH_MARKUP    BIT(1) // The text object was parsed with C2D_ParseColorMarkup
+
+typedef struct C2Di_TextSource_s C2Di_TextSource;
+
 struct C2D_TextBuf_s
 {
 	u32 reserved[2];
 	size_t glyphCount;
 	size_t glyphBufSize;
+	C2Di_TextSource* sources;
+	u32* colors;    // Colors used by markup in the buffer
+	size_t numColors;
+	size_t colorCap;
+	void* scratch;  // Temporary memory kept between calls (see C2D_TextOptimize)
+	size_t scratchSize;
 	C2Di_Glyph glyphs[0];
 };
 
+// Parse history of a text object, kept by C2D_TextUpdate in order to only re-parse what changed
+struct C2Di_TextSource_s
+{
+	C2Di_TextSource* next;
+	C2D_Font font;
+	size_t begin;  // Identifies the text object (its first glyph in the buffer)
+	size_t end;    // End of the text object as of the last parse
+	size_t limit;  // End of the glyph range owned by the text object
+	bool markup;   // The text object is parsed with C2D_ParseColorMarkup
+
+	char* str;     // Copy of the last parsed string
+	size_t strLen;
+	size_t strCap;
+	size_t stopPos; // Offset at which parsing stopped
+
+	struct
+	{
+		u32 srcEnd;   // Offset right past the character that produced the glyph
+		float penEnd; // Pen position after the character, in font units
+	}* glyphs;
+	size_t glyphCap;
+
+	struct
+	{
+		float width;
+		u32 words;
+	}* lines;
+	size_t lineCap;
+};
+
+typedef struct
+{
+	C2D_Font font;
+	C2D_TextBuf buf;
+	size_t limit;
+	u32 lineNo;
+	float width; // Pen position within the current line, in font units
+	u32 wordNum;
+	bool lastWasWhitespace;
+	bool streamed; // Load the glyph sheets of the font as they are first referenced
+	bool markup;   // Interpret color markup (see C2D_ParseColorMarkup)
+	C2Di_GlyphInfo* threadCache; // Set if other threads parse with the same font at the same time (see C2Di_ParseGlyphInfo)
+	u16 color;     // Color of the glyphs, as stored in C2Di_Glyph
+
+	C2Di_TextSource* src; // Optional parse history to fill in
+	const uint8_t* srcBase;
+} C2Di_ParseState;
+
 typedef struct C2Di_LineInfo_s
 {
 	u32 words;
@@ -42,19 +106,112 @@ typedef struct C2Di_WordInfo_s
 	u32 newLineNumber;
 } C2Di_WordInfo;
 
+typedef struct C2Di_BakedRun_s
+{
+	C3D_Tex* sheet;
+	u32 start; // First vertex of the run
+	u32 count; // Number of quads in the run
+} C2Di_BakedRun;
+
+struct C2D_BakedText_s
+{
+	C2D_Font font;
+	size_t numRuns;
+	size_t numQuads;
+	C2Di_Vertex* vertices;
+	C2Di_BakedRun runs[0];
+};
+
+struct C2D_TextArena_s
+{
+	C2D_TextArena next; // Next arena to clear at the end of the frame
+	size_t chunkGlyphs;
+	size_t peak;
+	C2D_TextBuf* chunks; // Only the last chunk is parsed into
+	size_t numChunks;
+	size_t chunkCap;
+};
+
+static C2D_TextArena s_textArenas;
+
+struct C2D_TextLayout_s
+{
+	C2D_Text text;
+	float scaleX;
+	float glyphH;
+	float width;
+	float height;
+	struct
+	{
+		float x, y;
+	} glyphPos[0];
+};
+
 static size_t C2Di_TextBufBufferSize(size_t maxGlyphs)
 {
 	return sizeof(struct C2D_TextBuf_s) + maxGlyphs*sizeof(C2Di_Glyph);
 }
 
-static int C2Di_GlyphComp(const void* _g1, const void* _g2)
+#define C2Di_UTF8_BATCH 16
+
+// Line and word numbers are stored in 16 bits, parsing stops before they would wrap around
+#define C2Di_MAX_LINES 0x10000
+#define C2Di_MAX_WORDS 0x10000
+
+static inline bool C2Di_HasZeroByte(u32 word)
+{
+	return ((word - 0x01010101U) & ~word & 0x80808080U) != 0;
+}
+
+// Decodes up to C2Di_UTF8_BATCH codepoints, stopping after a null character or a newline.
+// Invalid sequences decode to U+FFFD and consume a single byte, same as before.
+static size_t C2Di_DecodeUtf8Batch(u32* codes, u8* units, const uint8_t* p)
 {
-	const C2Di_Glyph* g1 = (C2Di_Glyph*)_g1;
-	const C2Di_Glyph* g2 = (C2Di_Glyph*)_g2;
-	int ret = (int)g1->sheet - (int)g2->sheet;
-	if (ret == 0)
-		ret = (int)g1 - (int)g2;
-	return ret;
+	size_t n = 0;
+	while (n < C2Di_UTF8_BATCH)
+	{
+		// Fast path: process four ASCII characters at a time. The first three bytes are checked one by one,
+		// so that the fourth one is at most the terminator and the word never extends past the string.
+		if (n + 4 <= C2Di_UTF8_BATCH && p[0] && p[1] && p[2])
+		{
+			u32 word;
+			memcpy(&word, p, sizeof(word));
+			if (!(word & 0x80808080U) && !C2Di_HasZeroByte(word) && !C2Di_HasZeroByte(word ^ 0x0A0A0A0AU))
+			{
+				codes[n+0] = p[0];
+				codes[n+1] = p[1];
+				codes[n+2] = p[2];
+				codes[n+3] = p[3];
+				units[n+0] = units[n+1] = units[n+2] = units[n+3] = 1;
+				p += 4;
+				n += 4;
+				continue;
+			}
+		}
+
+		uint32_t code;
+		ssize_t len;
+		if (*p < 0x80)
+		{
+			code = *p;
+			len = 1;
+		} else
+		{
+			len = decode_utf8(&code, p);
+			if (len == -1)
+			{
+				code = 0xFFFD;
+				len = 1;
+			}
+		}
+
+		codes[n] = code;
+		units[n++] = len;
+		p += len;
+		if (code == 0 || code == '\n')
+			break;
+	}
+	return n;
 }
 
 static void C2Di_TextEnsureLoad(void)
@@ -117,14 +274,94 @@ C2D_TextBuf C2D_TextBufResize(C2D_TextBuf buf, size_t maxGlyphs)
 
 }
 
+static void C2Di_TextSourceFree(C2Di_TextSource* src)
+{
+	free(src->str);
+	free(src->glyphs);
+	free(src->lines);
+	free(src);
+}
+
+static void C2Di_TextSourceFreeAll(C2D_TextBuf buf)
+{
+	while (buf->sources)
+	{
+		C2Di_TextSource* next = buf->sources->next;
+		C2Di_TextSourceFree(buf->sources);
+		buf->sources = next;
+	}
+}
+
+static C2Di_TextSource** C2Di_TextSourceFind(C2D_TextBuf buf, size_t begin)
+{
+	C2Di_TextSource** src;
+	for (src = &buf->sources; *src; src = &(*src)->next)
+		if ((*src)->begin == begin)
+			break;
+	return src;
+}
+
+static void C2Di_TextSourceDrop(C2D_TextBuf buf, size_t begin)
+{
+	C2Di_TextSource** src = C2Di_TextSourceFind(buf, begin);
+	if (*src)
+	{
+		C2Di_TextSource* next = (*src)->next;
+		C2Di_TextSourceFree(*src);
+		*src = next;
+	}
+}
+
+static bool C2Di_ArrayReserve(void** ptr, size_t* cap, size_t count, size_t elemSize)
+{
+	if (count <= *cap)
+		return true;
+
+	size_t newCap = *cap ? *cap : 16;
+	while (newCap < count)
+		newCap *= 2;
+
+	void* newPtr = realloc(*ptr, newCap*elemSize);
+	if (!newPtr)
+		return false;
+
+	*ptr = newPtr;
+	*cap = newCap;
+	return true;
+}
+
 void C2D_TextBufDelete(C2D_TextBuf buf)
 {
+	C2Di_TextSourceFreeAll(buf);
+	free(buf->colors);
+	free(buf->scratch);
 	free(buf);
 }
 
 void C2D_TextBufClear(C2D_TextBuf buf)
 {
+	C2Di_TextSourceFreeAll(buf);
 	buf->glyphCount = 0;
+	buf->numColors = 0;
+}
+
+// Returns the value to store in C2Di_Glyph::color for a color, adding it to the color table of the buffer.
+// If the table can't hold it, the glyphs get the color passed when drawing.
+static u16 C2Di_TextBufAddColor(C2D_TextBuf buf, u32 color)
+{
+	size_t i;
+	for (i = 0; i < buf->numColors; i ++)
+		if (buf->colors[i] == color)
+			return i+1;
+	if (buf->numColors == UINT16_MAX || !C2Di_ArrayReserve((void**)&buf->colors, &buf->colorCap, buf->numColors+1, sizeof(u32)))
+		return 0;
+	buf->colors[buf->numColors++] = color;
+	return buf->numColors;
+}
+
+static inline u32 C2Di_GlyphColor(C2D_TextBuf buf, const C2Di_Glyph* glyph, u32 color)
+{
+	return glyph->color ? buf->colors[glyph->color-1] : color;
 }
 
 size_t C2D_TextBufGetNumGlyphs(C2D_TextBuf buf)
@@ -132,254 +369,1216 @@ size_t C2D_TextBufGetNumGlyphs(C2D_TextBuf buf)
 	return buf->glyphCount;
 }
 
-const char* C2D_TextParseLine(C2D_Text* text, C2D_TextBuf buf, const char* str, u32 lineNo)
+C2D_TextArena C2D_TextArenaNew(size_t chunkGlyphs)
 {
-	return C2D_TextFontParseLine(text, NULL, buf, str, lineNo);
+	C2D_TextArena arena = (C2D_TextArena)calloc(1, sizeof(struct C2D_TextArena_s));
+	if (!arena) return NULL;
+	arena->chunkGlyphs = chunkGlyphs ? chunkGlyphs : 1;
+	arena->next = s_textArenas;
+	s_textArenas = arena;
+	return arena;
 }
 
-const char* C2D_TextFontParseLine(C2D_Text* text, C2D_Font font, C2D_TextBuf buf, const char* str, u32 lineNo)
+static void C2Di_TextArenaFreeChunks(C2D_TextArena arena, size_t first)
 {
-	const uint8_t* p = (const uint8_t*)str;
-	text->font  = font;
-	text->buf   = buf;
-	text->begin = buf->glyphCount;
-	text->width = 0.0f;
-	u32 wordNum = 0;
-	bool lastWasWhitespace = true;
-	while (buf->glyphCount < buf->glyphBufSize)
-	{
-		uint32_t code;
-		ssize_t units = decode_utf8(&code, p);
-		if (units == -1)
-		{
-			code = 0xFFFD;
-			units = 1;
-		} else if (code == 0 || code == '\n')
+	size_t i;
+	for (i = first; i < arena->numChunks; i ++)
+		C2D_TextBufDelete(arena->chunks[i]);
+	arena->numChunks = first;
+}
+
+void C2D_TextArenaDelete(C2D_TextArena arena)
+{
+	C2D_TextArena* link;
+	for (link = &s_textArenas; *link; link = &(*link)->next)
+		if (*link == arena)
 		{
+			*link = arena->next;
 			break;
 		}
-		p += units;
 
-		fontGlyphPos_s glyphData;
-		C2D_FontCalcGlyphPos(font, &glyphData, C2D_FontGlyphIndexFromCodePoint(font, code), 0, 1.0f, 1.0f);
-		if (glyphData.width > 0.0f)
-		{
-			C2Di_Glyph* glyph = &buf->glyphs[buf->glyphCount++];
-			if (font)
-				glyph->sheet = &font->glyphSheets[glyphData.sheetIndex];
-			else
-				glyph->sheet = &s_glyphSheets[glyphData.sheetIndex];
-			glyph->xPos            = text->width + glyphData.xOffset;
-			glyph->lineNo          = lineNo;
-			glyph->wordNo          = wordNum;
-			glyph->width           = glyphData.width;
-			glyph->texcoord.left   = glyphData.texcoord.left;
-			glyph->texcoord.top    = glyphData.texcoord.top;
-			glyph->texcoord.right  = glyphData.texcoord.right;
-			glyph->texcoord.bottom = glyphData.texcoord.bottom;
-			lastWasWhitespace = false;
-		}
-		else if (!lastWasWhitespace)
-		{
-			wordNum++;
-			lastWasWhitespace = true;
-		}
-		text->width += glyphData.xAdvance;
-	}
+	C2Di_TextArenaFreeChunks(arena, 0);
+	free(arena->chunks);
+	free(arena);
+}
 
-	// If we last parsed non-whitespace, increment the word counter
-	if (!lastWasWhitespace)
-		wordNum++;
+void C2D_TextArenaClear(C2D_TextArena arena)
+{
+	size_t i, used = 0;
+	for (i = 0; i < arena->numChunks; i ++)
+		used += arena->chunks[i]->glyphCount;
+	if (used > arena->peak)
+		arena->peak = used;
 
-	text->end = buf->glyphCount;
-	text->width *= font ? font->textScale : s_textScale;
-	text->lines = 1;
-	text->words = wordNum;
-	return (const char*)p;
+	if (arena->numChunks > 1)
+	{
+		// Replace the chunks with a single one that fits the whole peak, so that the next frames don't have to grow
+		size_t size = arena->peak > arena->chunkGlyphs ? arena->peak : arena->chunkGlyphs;
+		C2Di_TextArenaFreeChunks(arena, 0);
+		arena->chunks[0] = C2D_TextBufNew(size);
+		if (arena->chunks[0])
+			arena->numChunks = 1;
+	} else if (arena->numChunks)
+		C2D_TextBufClear(arena->chunks[0]);
 }
 
-const char* C2D_TextParse(C2D_Text* text, C2D_TextBuf buf, const char* str)
+size_t C2D_TextArenaGetPeak(C2D_TextArena arena)
 {
-	return C2D_TextFontParse(text, NULL, buf, str);
+	size_t i, used = 0;
+	for (i = 0; i < arena->numChunks; i ++)
+		used += arena->chunks[i]->glyphCount;
+	return used > arena->peak ? used : arena->peak;
 }
 
-const char* C2D_TextFontParse(C2D_Text* text, C2D_Font font, C2D_TextBuf buf, const char* str)
+void C2Di_TextArenaFrameEnd(void)
 {
-	text->font   = font;
-	text->buf    = buf;
-	text->begin  = buf->glyphCount;
-	text->width  = 0.0f;
-	text->words  = 0;
-	text->lines  = 0;
+	C2D_TextArena arena;
+	for (arena = s_textArenas; arena; arena = arena->next)
+		C2D_TextArenaClear(arena);
+}
 
-	for (;;)
+static inline void C2Di_ParseStateInit(C2Di_ParseState* st, C2D_Font font, C2D_TextBuf buf, u32 lineNo)
+{
+	st->font              = font;
+	st->buf               = buf;
+	st->limit             = buf->glyphBufSize;
+	st->lineNo            = lineNo;
+	st->width             = 0.0f;
+	st->wordNum           = 0;
+	st->lastWasWhitespace = true;
+	st->streamed          = font && font->stream;
+	st->markup            = false;
+	st->threadCache       = NULL;
+	st->color             = 0;
+	st->src               = NULL;
+	st->srcBase           = NULL;
+}
+
+// Adds a character to the current line, returns whether it produced a glyph (as opposed to whitespace)
+static inline bool C2Di_ParseChar(C2Di_ParseState* st, const C2Di_GlyphInfo* glyphData, float xOffset, float xAdvance)
+{
+	bool isGlyph = glyphData->width > 0.0f;
+	if (isGlyph)
 	{
-		C2D_Text temp;
-		str = C2D_TextFontParseLine(&temp, font, buf, str, text->lines++);
-		text->words += temp.words;
-		if (temp.width > text->width)
-			text->width = temp.width;
-		if (!str || *str != '\n')
-			break;
-		str++;
+		C2Di_Glyph* glyph = &st->buf->glyphs[st->buf->glyphCount++];
+		glyph->xPos       = st->width + xOffset;
+		glyph->sheet      = glyphData->sheetIndex;
+		glyph->sheetGlyph = glyphData->sheetGlyph;
+		glyph->lineNo     = st->lineNo;
+		glyph->wordNo     = st->wordNum;
+		glyph->width      = glyphData->width;
+		glyph->flags      = 0;
+		glyph->color      = st->color;
+		st->lastWasWhitespace = false;
+		if (st->streamed)
+			C2Di_FontLoadSheet(st->font, glyph->sheet); // On failure, it is tried again when drawing
 	}
-
-	text->end = buf->glyphCount;
-	return str;
+	else if (!st->lastWasWhitespace)
+	{
+		st->wordNum++;
+		st->lastWasWhitespace = true;
+	}
+	st->width += xAdvance;
+	return isGlyph;
 }
 
-void C2D_TextOptimize(const C2D_Text* text)
+static inline int C2Di_HexDigit(uint8_t c)
 {
-	// Dirty and probably not very efficient/overkill, but it should work
-	qsort(&text->buf->glyphs[text->begin], text->end-text->begin, sizeof(C2Di_Glyph), C2Di_GlyphComp);
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if ((c|0x20) >= 'a' && (c|0x20) <= 'f')
+		return (c|0x20) - 'a' + 10;
+	return -1;
 }
 
-void C2D_TextGetDimensions(const C2D_Text* text, float scaleX, float scaleY, float* outWidth, float* outHeight)
+// Parses "#RRGGBB}", "#RRGGBBAA}" or "#}" after a '{', returns the end of the markup or NULL if it isn't one
+static const uint8_t* C2Di_ParseColorMarkup(C2Di_ParseState* st, const uint8_t* p)
 {
-	if (outWidth)
-		*outWidth  = scaleX*text->width;
-	if (outHeight)
+	if (*p++ != '#')
+		return NULL;
+
+	u32 value = 0;
+	int digits, digit;
+	for (digits = 0; digits < 8 && (digit = C2Di_HexDigit(p[digits])) >= 0; digits ++)
+		value = (value << 4) | digit;
+	if (p[digits] != '}')
+		return NULL;
+
+	if (digits == 6)
+		value = (value << 8) | 0xFF;
+	else if (digits != 8)
 	{
-		if (text->font)
-			*outHeight = ceilf(scaleY*text->font->textScale*text->font->cfnt->finf.lineFeed)*text->lines;
-		else
-			*outHeight = ceilf(scaleY*s_textScale*fontGetInfo(fontGetSystemFont())->lineFeed)*text->lines;
+		if (digits != 0)
+			return NULL;
+		st->color = 0;
+		return p + 1;
 	}
+	st->color = C2Di_TextBufAddColor(st->buf, C2D_Color32(value >> 24, value >> 16, value >> 8, value));
+	return p + digits + 1;
 }
 
-static inline void C2Di_CalcLineInfo(const C2D_Text* text, C2Di_LineInfo* lines, C2Di_WordInfo* words)
+#define C2Di_THREAD_GLYPHCACHE_SIZE 512
+
+// Glyph lookup for threads parsing at the same time: the glyph cache of the font is only read, glyphs missing
+// from it go to a small direct mapped cache of the thread instead
+static inline const C2Di_GlyphInfo* C2Di_ParseGlyphInfo(C2Di_ParseState* st, u32 code)
 {
-	C2Di_Glyph* begin = &text->buf->glyphs[text->begin];
-	C2Di_Glyph* end   = &text->buf->glyphs[text->end];
-	C2Di_Glyph* cur;
-	// Get information about lines
-	memset(lines, 0, sizeof(C2Di_LineInfo) * text->lines);
-	for (cur = begin; cur != end; cur++)
-		if (cur->wordNo >= lines[cur->lineNo].words)
-			lines[cur->lineNo].words = cur->wordNo + 1;
-	for (u32 i = 1; i < text->lines; i++)
-		lines[i].wordStart = lines[i-1].wordStart + lines[i-1].words;
+	const C2Di_GlyphInfo* info = C2Di_FontPeekGlyphInfo(st->font, code);
+	if (info)
+		return info;
 
-	// Get information about words
-	for (u32 i = 0; i < text->words; i++)
-	{
-		words[i].start = NULL;
-		words[i].end = NULL;
-		words[i].wrapXOffset = 0;
-		words[i].newLineNumber = 0;
-	}
-	for (cur = begin; cur != end; cur++)
-	{
-		u32 consecutiveWordNum = cur->wordNo + lines[cur->lineNo].wordStart;
-		if (!words[consecutiveWordNum].end || cur->xPos + cur->width > words[consecutiveWordNum].end->xPos + words[consecutiveWordNum].end->width)
-			words[consecutiveWordNum].end = cur;
-		if (!words[consecutiveWordNum].start || cur->xPos < words[consecutiveWordNum].start->xPos)
-			words[consecutiveWordNum].start = cur;
-		words[consecutiveWordNum].newLineNumber = cur->lineNo;
-	}
+	C2Di_GlyphInfo* slot = &st->threadCache[code & (C2Di_THREAD_GLYPHCACHE_SIZE-1)];
+	if (slot->code != code)
+		C2Di_FontFillGlyphInfo(st->font, slot, code);
+	return slot;
 }
 
-static inline void C2Di_CalcLineWidths(float* widths, const C2D_Text* text, const C2Di_WordInfo* words, bool wrap)
+static const uint8_t* C2Di_ParseLine(C2Di_ParseState* st, const uint8_t* p)
 {
-	u32 currentWord = 0;
-	if (words)
+	C2D_TextBuf buf = st->buf;
+	C2Di_TextSource* src = st->src;
+	u32 codes[C2Di_UTF8_BATCH];
+	u8 units[C2Di_UTF8_BATCH];
+	size_t numCodes = 0, curCode = 0;
+	while (buf->glyphCount < st->limit)
 	{
-		while (currentWord != text->words)
+		if (curCode == numCodes)
 		{
-			u32 nextLineWord = currentWord + 1;
-			// Advance nextLineWord to the next word that's on a different line, or the end
-			if (wrap)
-			{
-				while (nextLineWord != text->words && words[nextLineWord].newLineNumber == words[currentWord].newLineNumber) nextLineWord++;
-				// Finally, set the new line width
-				widths[words[currentWord].newLineNumber] = words[nextLineWord-1].end->xPos + words[nextLineWord-1].end->width - words[currentWord].start->xPos;
-			}
-			else
+			numCodes = C2Di_DecodeUtf8Batch(codes, units, p);
+			curCode = 0;
+		}
+
+		u32 code = codes[curCode];
+		if (code == 0 || code == '\n' || st->wordNum == C2Di_MAX_WORDS)
+			break;
+		p += units[curCode++];
+
+		// Markup produces no glyphs, "{{" stands for '{'. Decoding resumes after either of them.
+		if (code == '{' && st->markup)
+		{
+			bool literal = *p == '{';
+			const uint8_t* end = literal ? p + 1 : C2Di_ParseColorMarkup(st, p);
+			if (end)
 			{
-				while (nextLineWord != text->words && words[nextLineWord].start->lineNo == words[currentWord].start->lineNo) nextLineWord++;
-				// Finally, set the new line width
-				widths[words[currentWord].start->lineNo] = words[nextLineWord-1].end->xPos + words[nextLineWord-1].end->width - words[currentWord].start->xPos;
+				p = end;
+				numCodes = curCode = 0;
+				if (!literal)
+					continue;
 			}
+		}
 
-			currentWord = nextLineWord;
+		const C2Di_GlyphInfo* glyphData = st->threadCache ? C2Di_ParseGlyphInfo(st, code) : C2Di_FontGetGlyphInfo(st->font, code);
+		if (C2Di_ParseChar(st, glyphData, glyphData->xOffset, glyphData->xAdvance) && src)
+		{
+			size_t i = buf->glyphCount - src->begin;
+			if (C2Di_ArrayReserve((void**)&src->glyphs, &src->glyphCap, i, sizeof(*src->glyphs)))
+			{
+				src->glyphs[i-1].srcEnd = p - st->srcBase;
+				src->glyphs[i-1].penEnd = st->width;
+			} else
+				src = st->src = NULL;
 		}
 	}
-	else
+
+	// If we last parsed non-whitespace, increment the word counter
+	if (!st->lastWasWhitespace)
 	{
-		memset(widths, 0, sizeof(float) * text->lines);
-		for (C2Di_Glyph* cur = &text->buf->glyphs[text->begin]; cur != &text->buf->glyphs[text->end]; cur++)
-			if (cur->xPos + cur->width > widths[cur->lineNo])
-				widths[cur->lineNo] = cur->xPos + cur->width;
+		st->wordNum++;
+		st->lastWasWhitespace = true;
 	}
+
+	return p;
 }
 
-void C2D_DrawText(const C2D_Text* text, u32 flags, float x, float y, float z, float scaleX, float scaleY, ...)
+// Parses lines until the end of the string (or buffer). The text object contains the information
+// about any lines that were completed before st->lineNo.
+static const uint8_t* C2Di_ParseText(C2D_Text* text, C2Di_ParseState* st, const uint8_t* p)
 {
-	// If there are no words, we can't do the math calculations necessary with them. Just return; nothing would be drawn anyway.
-	if (text->words == 0)
-		return;
-	C2Di_Glyph* begin = &text->buf->glyphs[text->begin];
-	C2Di_Glyph* end   = &text->buf->glyphs[text->end];
-	C2Di_Glyph* cur;
-	CFNT_s* systemFont = fontGetSystemFont();
-
-	float glyphZ = z;
-	float glyphH;
-	float dispY;
-	if (text->font)
-	{
-		scaleX *= text->font->textScale;
-		scaleY *= text->font->textScale;
-		glyphH = scaleY*text->font->cfnt->finf.tglp->cellHeight;
-		dispY = ceilf(scaleY*text->font->cfnt->finf.lineFeed);
-	} else
+	float scale = st->font ? st->font->textScale : s_textScale;
+	for (;;)
 	{
-		scaleX *= s_textScale;
-		scaleY *= s_textScale;
-		glyphH = scaleY*fontGetGlyphInfo(systemFont)->cellHeight;
-		dispY = ceilf(scaleY*fontGetInfo(systemFont)->lineFeed);
-	}
-	u32 color = 0xFF000000;
-	float maxWidth = scaleX*text->width;
+		p = C2Di_ParseLine(st, p);
 
-	va_list va;
-	va_start(va, scaleY);
+		float lineWidth = st->width*scale;
+		text->words += st->wordNum;
+		text->lines = st->lineNo + 1;
+		if (lineWidth > text->width)
+			text->width = lineWidth;
 
-	if (flags & C2D_AtBaseline)
-	{
-		if (text->font)
-			y -= scaleY*text->font->cfnt->finf.tglp->baselinePos;
-		else
-			y -= scaleY*fontGetGlyphInfo(systemFont)->baselinePos;
+		C2Di_TextSource* src = st->src;
+		if (src)
+		{
+			if (C2Di_ArrayReserve((void**)&src->lines, &src->lineCap, text->lines, sizeof(*src->lines)))
+			{
+				src->lines[st->lineNo].width = lineWidth;
+				src->lines[st->lineNo].words = st->wordNum;
+			} else
+				st->src = NULL;
+		}
+
+		if (*p != '\n' || st->lineNo+1 == C2Di_MAX_LINES)
+			break;
+		p++;
+
+		st->lineNo++;
+		st->width = 0.0f;
+		st->wordNum = 0;
+		st->lastWasWhitespace = true;
 	}
-	if (flags & C2D_WithColor)
-		color = va_arg(va, u32);
-	if (flags & C2D_WordWrap)
-		maxWidth = va_arg(va, double); // Passed as float, but varargs promotes to double.
 
-	va_end(va);
+	text->end = st->buf->glyphCount;
+	return p;
+}
 
-	C2Di_SetMode(C2DiF_Mode_Text);
+const char* C2D_TextParseLine(C2D_Text* text, C2D_TextBuf buf, const char* str, u32 lineNo)
+{
+	return C2D_TextFontParseLine(text, NULL, buf, str, lineNo);
+}
 
-	C2Di_LineInfo* lines = NULL;
-	C2Di_WordInfo* words = NULL;
+const char* C2D_TextFontParseLine(C2D_Text* text, C2D_Font font, C2D_TextBuf buf, const char* str, u32 lineNo)
+{
+	C2Di_ParseState st;
+	C2Di_ParseStateInit(&st, font, buf, lineNo < C2Di_MAX_LINES ? lineNo : C2Di_MAX_LINES-1);
+	if (buf->sources)
+		C2Di_TextSourceDrop(buf, buf->glyphCount);
 
-	if (flags & C2D_WordWrap)
-	{
-		lines = alloca(sizeof(*lines)*text->lines);
-		words = alloca(sizeof(*words)*text->words);
-		C2Di_CalcLineInfo(text, lines, words);
-		// The first word will never have a wrap offset in X or Y
-		for (u32 i = 1; i < text->words; i++)
-		{
-			// If the current word was originally on a different line than the last one, only the difference between new line number and original line number should be the same
-			if (words[i-1].start->lineNo != words[i].start->lineNo)
-			{
-				words[i].wrapXOffset = 0;
-				words[i].newLineNumber = words[i].start->lineNo + (words[i-1].newLineNumber - words[i-1].start->lineNo);
-			}
-			// Otherwise, if the current word goes over the width, with the previous word's offset taken into account...
-			else if (scaleX*(words[i-1].wrapXOffset + words[i].end->xPos + words[i].end->width) > maxWidth)
+	text->font  = font;
+	text->buf   = buf;
+	text->begin = buf->glyphCount;
+	const uint8_t* p = C2Di_ParseLine(&st, (const uint8_t*)str);
+
+	text->end   = buf->glyphCount;
+	text->width = st.width * (font ? font->textScale : s_textScale);
+	text->lines = 1;
+	text->words = st.wordNum;
+	return (const char*)p;
+}
+
+const char* C2D_TextParse(C2D_Text* text, C2D_TextBuf buf, const char* str)
+{
+	return C2D_TextFontParse(text, NULL, buf, str);
+}
+
+static const char* C2Di_TextFontParse(C2D_Text* text, C2Di_ParseState* st, const char* str)
+{
+	C2D_TextBuf buf = st->buf;
+	if (buf->sources)
+		C2Di_TextSourceDrop(buf, buf->glyphCount);
+
+	text->font   = st->font;
+	text->buf    = buf;
+	text->begin  = buf->glyphCount;
+	text->width  = 0.0f;
+	text->words  = 0;
+	text->lines  = 0;
+	const char* end = (const char*)C2Di_ParseText(text, st, (const uint8_t*)str);
+	if (st->markup && text->end != text->begin)
+		buf->glyphs[text->begin].flags |= C2Di_GLYPH_MARKUP; // For C2D_TextUpdate
+	return end;
+}
+
+const char* C2D_TextFontParse(C2D_Text* text, C2D_Font font, C2D_TextBuf buf, const char* str)
+{
+	C2Di_ParseState st;
+	C2Di_ParseStateInit(&st, font, buf, 0);
+	return C2Di_TextFontParse(text, &st, str);
+}
+
+const char* C2D_TextFontParseEx(C2D_Text* text, C2D_Font font, C2D_TextBuf buf, const char* str, u32 flags)
+{
+	C2Di_ParseState st;
+	C2Di_ParseStateInit(&st, font, buf, 0);
+	st.markup = (flags & C2D_ParseColorMarkup) != 0;
+	str = C2Di_TextFontParse(text, &st, str);
+	if (flags & C2D_ParseOptimize)
+		C2D_TextOptimize(text);
+	return str;
+}
+
+#define C2Di_PARSE_MAX_THREADS 8
+
+// A contiguous range of the strings given to C2D_TextFontParseMany, parsed by one thread into its own buffer
+typedef struct
+{
+	C2D_Text* texts;
+	const char* const* strs;
+	size_t numStrs;
+	C2D_Font font;
+	u32 flags;
+	C2D_TextBuf buf;
+	C2Di_GlyphInfo* glyphCache; // See C2Di_ParseGlyphInfo
+} C2Di_ParseJob;
+
+static void C2Di_ParseJobRun(void* arg)
+{
+	C2Di_ParseJob* job = (C2Di_ParseJob*)arg;
+	size_t i;
+	for (i = 0; i < job->numStrs; i ++)
+	{
+		C2Di_ParseState st;
+		C2Di_ParseStateInit(&st, job->font, job->buf, 0);
+		st.markup      = (job->flags & C2D_ParseColorMarkup) != 0;
+		st.threadCache = job->glyphCache;
+		st.streamed    = false; // Loading sheets isn't thread-safe, they are loaded when first drawn instead
+		C2Di_TextFontParse(&job->texts[i], &st, job->strs[i]);
+		if (job->flags & C2D_ParseOptimize)
+			C2D_TextOptimize(&job->texts[i]);
+	}
+}
+
+#ifdef __3DS__
+#define C2Di_PARSE_STACK_SIZE (16*1024)
+
+typedef Thread C2Di_ParseThread;
+
+// Other than the one running the application, the cores that can be used are the extra application core of the
+// New 3DS and the system core if the application was given time on it (see APT_SetAppCpuTimeLimit)
+static size_t C2Di_ParseCores(s32* cores)
+{
+	size_t numCores = 0;
+	bool isNew3DS = false;
+	u32 percent = 0;
+	if (R_SUCCEEDED(APT_CheckNew3DS(&isNew3DS)) && isNew3DS)
+		cores[numCores++] = 2;
+	if (R_SUCCEEDED(APT_GetAppCpuTimeLimit(&percent)) && percent > 0)
+		cores[numCores++] = 1;
+	return numCores;
+}
+
+// pthreads can't be pinned to a core, use libctru threads to make sure the workers run on the other cores
+static bool C2Di_ParseThreadStart(C2Di_ParseThread* thread, C2Di_ParseJob* job, s32 core)
+{
+	s32 prio = 0x30;
+	svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+	*thread = threadCreate(C2Di_ParseJobRun, job, C2Di_PARSE_STACK_SIZE, prio, core, false);
+	return *thread != NULL;
+}
+
+static void C2Di_ParseThreadJoin(C2Di_ParseThread thread)
+{
+	threadJoin(thread, U64_MAX);
+	threadFree(thread);
+}
+#else
+typedef pthread_t C2Di_ParseThread;
+
+static size_t C2Di_ParseCores(s32* cores)
+{
+	long numCores = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	size_t i;
+	for (i = 0; (long)i < numCores && i < C2Di_PARSE_MAX_THREADS-1; i ++)
+		cores[i] = -1; // Left to the scheduler
+	return i;
+}
+
+static void* C2Di_ParseThreadEntry(void* arg)
+{
+	C2Di_ParseJobRun(arg);
+	return NULL;
+}
+
+static bool C2Di_ParseThreadStart(C2Di_ParseThread* thread, C2Di_ParseJob* job, s32 core)
+{
+	(void)core;
+	return pthread_create(thread, NULL, C2Di_ParseThreadEntry, job) == 0;
+}
+
+static void C2Di_ParseThreadJoin(C2Di_ParseThread thread)
+{
+	pthread_join(thread, NULL);
+}
+#endif
+
+// Appends the glyphs and colors parsed by a job to the buffer, and points its text objects at them
+static bool C2Di_ParseJobMerge(C2D_TextBuf buf, const C2Di_ParseJob* job)
+{
+	C2D_TextBuf src = job->buf;
+	u16* colorMap = NULL;
+	size_t i, offset = buf->glyphCount;
+	if (src->numColors)
+	{
+		colorMap = (u16*)malloc(src->numColors*sizeof(u16));
+		if (!colorMap)
+			return false;
+		for (i = 0; i < src->numColors; i ++)
+			colorMap[i] = C2Di_TextBufAddColor(buf, src->colors[i]);
+	}
+
+	C2Di_Glyph* glyphs = &buf->glyphs[offset];
+	memcpy(glyphs, src->glyphs, src->glyphCount*sizeof(C2Di_Glyph));
+	if (colorMap)
+	{
+		for (i = 0; i < src->glyphCount; i ++)
+			if (glyphs[i].color)
+				glyphs[i].color = colorMap[glyphs[i].color-1];
+		free(colorMap);
+	}
+	buf->glyphCount += src->glyphCount;
+
+	for (i = 0; i < job->numStrs; i ++)
+	{
+		job->texts[i].buf    = buf;
+		job->texts[i].begin += offset;
+		job->texts[i].end   += offset;
+	}
+	return true;
+}
+
+C2D_TextBuf C2D_TextFontParseMany(C2D_Text* texts, C2D_Font font, const char* const* strs, size_t numStrs, u32 flags, u32 maxThreads)
+{
+	C2Di_TextEnsureLoad();
+
+	s32 cores[C2Di_PARSE_MAX_THREADS-1];
+	size_t numJobs = C2Di_ParseCores(cores) + 1;
+	if (maxThreads && numJobs > maxThreads)
+		numJobs = maxThreads;
+	if (numJobs > numStrs)
+		numJobs = numStrs ? numStrs : 1;
+
+	// Split the strings into contiguous ranges of about the same length. Every glyph comes from at least
+	// one byte of its string, so the length of a range is enough room for its glyphs.
+	size_t i, numBytes = 0;
+	for (i = 0; i < numStrs; i ++)
+		numBytes += strlen(strs[i]);
+
+	C2Di_ParseJob jobs[C2Di_PARSE_MAX_THREADS];
+	size_t j, first = 0, bytes = 0;
+	bool ok = true;
+	for (j = 0; j < numJobs; j ++)
+	{
+		C2Di_ParseJob* job = &jobs[j];
+		size_t jobBytes = 0, target = numBytes*(j+1)/numJobs;
+		for (i = first; i < numStrs && (j == numJobs-1 || bytes < target || i == first); i ++)
+		{
+			size_t len = strlen(strs[i]);
+			bytes += len;
+			jobBytes += len;
+		}
+
+		job->texts   = &texts[first];
+		job->strs    = &strs[first];
+		job->numStrs = i - first;
+		job->font    = font;
+		job->flags   = flags;
+		job->buf     = ok ? C2D_TextBufNew(jobBytes) : NULL;
+		job->glyphCache = ok ? (C2Di_GlyphInfo*)malloc(C2Di_THREAD_GLYPHCACHE_SIZE*sizeof(C2Di_GlyphInfo)) : NULL;
+		ok = ok && job->buf && job->glyphCache;
+		if (ok)
+		{
+			size_t k;
+			for (k = 0; k < C2Di_THREAD_GLYPHCACHE_SIZE; k ++)
+				job->glyphCache[k].code = C2Di_GLYPHCACHE_EMPTY;
+		}
+		first = i;
+	}
+
+	C2D_TextBuf buf = NULL;
+	if (ok)
+	{
+		// Nothing is added to the glyph cache of the font while the threads run, make sure the most common
+		// codepoints are already in it
+		C2Di_FontFillDirectCache(font);
+
+		// The calling thread parses the first range itself
+		C2Di_ParseThread threads[C2Di_PARSE_MAX_THREADS];
+		bool started[C2Di_PARSE_MAX_THREADS];
+		for (j = 1; j < numJobs; j ++)
+			started[j] = C2Di_ParseThreadStart(&threads[j], &jobs[j], cores[j-1]);
+		C2Di_ParseJobRun(&jobs[0]);
+
+		size_t numGlyphs = jobs[0].buf->glyphCount;
+		for (j = 1; j < numJobs; j ++)
+		{
+			if (started[j])
+				C2Di_ParseThreadJoin(threads[j]);
+			else
+				C2Di_ParseJobRun(&jobs[j]);
+			numGlyphs += jobs[j].buf->glyphCount;
+		}
+
+		buf = C2D_TextBufNew(numGlyphs);
+		for (j = 0; buf && j < numJobs; j ++)
+		{
+			if (!C2Di_ParseJobMerge(buf, &jobs[j]))
+			{
+				C2D_TextBufDelete(buf);
+				buf = NULL;
+			}
+		}
+	}
+
+	for (j = 0; j < numJobs; j ++)
+	{
+		if (jobs[j].buf)
+			C2D_TextBufDelete(jobs[j].buf);
+		free(jobs[j].glyphCache);
+	}
+	return buf;
+}
+
+// String tables as written by tools/strtab.c: a header, then the strings, then all of their glyphs.
+// Everything is little endian and laid out exactly like these structures.
+#define C2Di_TABLE_VERSION 1
+
+typedef struct
+{
+	char magic[4]; // "C2ST"
+	u16 version;
+	u16 numSheets; // Glyph sheet layout of the font the table was made for
+	u16 glyphsPerSheet;
+	u16 cellHeight;
+	u32 numStrings;
+	u32 numGlyphs;
+} C2Di_TableHeader;
+
+typedef struct
+{
+	u32 firstGlyph;
+	u32 numGlyphs;
+	float width; // Widest line, in font units
+	u32 lines;
+	u32 words;
+} C2Di_TableString;
+
+typedef struct
+{
+	float xPos;
+	u16 sheet;
+	u16 sheetGlyph;
+	u16 lineNo;
+	u16 wordNo;
+	u16 width;
+	u16 reserved;
+} C2Di_TableGlyph;
+
+// The drawing code trusts the line and word numbers of the glyphs, which must be as the parser produces them:
+// in order, within the lines of the string, and numbering the words of each line from 0 without gaps
+static bool C2Di_TableStringValid(const C2Di_TableString* str, const C2Di_TableGlyph* glyphs)
+{
+	if (str->lines > C2Di_MAX_LINES || (str->numGlyphs && !str->lines))
+		return false;
+
+	u32 words = 0, i;
+	for (i = 0; i < str->numGlyphs; i ++)
+	{
+		const C2Di_TableGlyph* glyph = &glyphs[i];
+		if (glyph->lineNo >= str->lines)
+			return false;
+		if (i == 0 || glyph->lineNo != glyph[-1].lineNo)
+		{
+			if ((i > 0 && glyph->lineNo < glyph[-1].lineNo) || glyph->wordNo != 0)
+				return false;
+			words++;
+		}
+		else if (glyph->wordNo == glyph[-1].wordNo + 1)
+			words++;
+		else if (glyph->wordNo != glyph[-1].wordNo)
+			return false;
+	}
+	return words == str->words;
+}
+
+C2D_TextBuf C2D_TextTableLoad(C2D_Text* texts, size_t numTexts, C2D_Font font, const void* data, size_t size)
+{
+	const C2Di_TableHeader* header = (const C2Di_TableHeader*)data;
+	if (size < sizeof(C2Di_TableHeader) || memcmp(header->magic, "C2ST", 4) != 0 || header->version != C2Di_TABLE_VERSION)
+		return NULL;
+	if (numTexts > header->numStrings || (size - sizeof(C2Di_TableHeader)) / sizeof(C2Di_TableString) < header->numStrings)
+		return NULL;
+	const C2Di_TableString* strings = (const C2Di_TableString*)&header[1];
+	const C2Di_TableGlyph* glyphs = (const C2Di_TableGlyph*)&strings[header->numStrings];
+	if ((size - ((const u8*)glyphs - (const u8*)data)) / sizeof(C2Di_TableGlyph) < header->numGlyphs)
+		return NULL;
+
+	// The glyphs are only valid for fonts with the same sheets
+	C2Di_TextEnsureLoad();
+	TGLP_s* tglp = C2D_FontGetInfo(font)->tglp;
+	if (header->numSheets != tglp->nSheets || header->glyphsPerSheet != tglp->nRows*tglp->nLines || header->cellHeight != tglp->cellHeight)
+		return NULL;
+
+	size_t i, numGlyphs = 0;
+	for (i = 0; i < numTexts; i ++)
+	{
+		if (strings[i].firstGlyph != numGlyphs || strings[i].numGlyphs > header->numGlyphs - numGlyphs)
+			return NULL;
+		if (!C2Di_TableStringValid(&strings[i], &glyphs[numGlyphs]))
+			return NULL;
+		numGlyphs += strings[i].numGlyphs;
+	}
+
+	C2D_TextBuf buf = C2D_TextBufNew(numGlyphs);
+	if (!buf)
+		return NULL;
+	for (i = 0; i < numGlyphs; i ++)
+	{
+		if (glyphs[i].sheet >= header->numSheets || glyphs[i].sheetGlyph >= header->glyphsPerSheet || glyphs[i].width > 0xFF)
+		{
+			C2D_TextBufDelete(buf);
+			return NULL;
+		}
+		C2Di_Glyph* glyph = &buf->glyphs[i];
+		glyph->xPos       = glyphs[i].xPos;
+		glyph->sheet      = glyphs[i].sheet;
+		glyph->sheetGlyph = glyphs[i].sheetGlyph;
+		glyph->lineNo     = glyphs[i].lineNo;
+		glyph->wordNo     = glyphs[i].wordNo;
+		glyph->width      = glyphs[i].width;
+		glyph->flags      = 0;
+		glyph->color      = 0;
+	}
+	buf->glyphCount = numGlyphs;
+
+	float scale = font ? font->textScale : s_textScale;
+	for (i = 0; i < numTexts; i ++)
+	{
+		C2D_Text* text = &texts[i];
+		text->font  = font;
+		text->buf   = buf;
+		text->begin = strings[i].firstGlyph;
+		text->end   = strings[i].firstGlyph + strings[i].numGlyphs;
+		text->width = strings[i].width*scale;
+		text->lines = strings[i].lines;
+		text->words = strings[i].words;
+	}
+	return buf;
+}
+
+#define C2Di_NUMBER_MAX 64
+
+// Adds an ASCII number (as written by C2Di_FormatNumber) to the buffer as a single line of text
+static bool C2Di_ParseNumber(C2D_Text* text, C2D_Font font, C2D_TextBuf buf, const char* str, size_t len, u32 flags)
+{
+	C2Di_ParseState st;
+	C2Di_ParseStateInit(&st, font, buf, 0);
+	if (buf->sources)
+		C2Di_TextSourceDrop(buf, buf->glyphCount);
+
+	text->font  = font;
+	text->buf   = buf;
+	text->begin = buf->glyphCount;
+
+	float digitAdvance = (flags & C2D_NumFixedWidth) ? C2Di_FontGetDigitAdvance(font) : 0.0f;
+	size_t i;
+	for (i = 0; i < len && buf->glyphCount < st.limit; i ++)
+	{
+		const C2Di_GlyphInfo* glyphData = C2Di_FontGetGlyphInfo(font, (u8)str[i]);
+		float xOffset  = glyphData->xOffset;
+		float xAdvance = glyphData->xAdvance;
+		if (digitAdvance > 0.0f && str[i] >= '0' && str[i] <= '9')
+		{
+			// Center the digit within the advance of the widest one
+			xOffset += (digitAdvance - xAdvance)/2;
+			xAdvance = digitAdvance;
+		}
+		C2Di_ParseChar(&st, glyphData, xOffset, xAdvance);
+	}
+	if (!st.lastWasWhitespace)
+		st.wordNum++;
+
+	text->end   = buf->glyphCount;
+	text->width = st.width * (font ? font->textScale : s_textScale);
+	text->lines = 1;
+	text->words = st.wordNum;
+	return i == len;
+}
+
+// Writes the digits of a number, returns the length of the string (not null terminated)
+static size_t C2Di_FormatNumber(char* out, bool negative, u64 value, u32 decimals, const C2D_NumFormat* fmt)
+{
+	char temp[C2Di_NUMBER_MAX];
+	size_t len = 0, i;
+	u32 minDigits = fmt ? fmt->minDigits : 0;
+	u32 flags = fmt ? fmt->flags : 0;
+	if (minDigits > 32)
+		minDigits = 32;
+
+	// Written backwards, using 32-bit divisions as soon as the value allows it
+	u32 numDigits = 0;
+	for (;;)
+	{
+		if (numDigits == decimals && decimals)
+			temp[len++] = '.';
+		else if (numDigits > decimals && (numDigits-decimals) % 3 == 0 && (flags & C2D_NumGrouping))
+			temp[len++] = ',';
+
+		u32 digit;
+		if (value > UINT32_MAX)
+		{
+			digit = value % 10;
+			value /= 10;
+		} else
+		{
+			u32 value32 = value;
+			digit = value32 % 10;
+			value = value32 / 10;
+		}
+		temp[len++] = '0' + digit;
+		numDigits++;
+
+		if (!value && numDigits > decimals && numDigits-decimals >= minDigits)
+			break;
+	}
+
+	if (negative)
+		temp[len++] = '-';
+	else if (flags & C2D_NumPlusSign)
+		temp[len++] = '+';
+
+	for (i = 0; i < len; i ++)
+		out[i] = temp[len-1-i];
+	return len;
+}
+
+bool C2D_TextParseInt(C2D_Text* text, C2D_Font font, C2D_TextBuf buf, s64 value, const C2D_NumFormat* fmt)
+{
+	char str[C2Di_NUMBER_MAX];
+	u64 absValue = value < 0 ? -(u64)value : (u64)value;
+	size_t len = C2Di_FormatNumber(str, value < 0, absValue, 0, fmt);
+	return C2Di_ParseNumber(text, font, buf, str, len, fmt ? fmt->flags : 0);
+}
+
+bool C2D_TextParseFloat(C2D_Text* text, C2D_Font font, C2D_TextBuf buf, double value, const C2D_NumFormat* fmt)
+{
+	static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+	char str[C2Di_NUMBER_MAX];
+	size_t len;
+	u32 decimals = fmt ? fmt->decimals : 0;
+	if (decimals > 9)
+		decimals = 9;
+
+	double scaled = fabs(value)*powers[decimals] + 0.5;
+	if (scaled < 18446744073709551616.0) // 2^64
+		len = C2Di_FormatNumber(str, signbit(value) && (u64)scaled != 0, (u64)scaled, decimals, fmt);
+	else
+	{
+		// Too large for the integer path (or not a number at all), fall back to the C library
+		int ret = snprintf(str, sizeof(str), "%.*g", (int)decimals + 1, value);
+		len = ret < 0 ? 0 : (size_t)ret < sizeof(str) ? (size_t)ret : sizeof(str)-1;
+	}
+	return C2Di_ParseNumber(text, font, buf, str, len, fmt ? fmt->flags : 0);
+}
+
+const char* C2D_TextArenaParse(C2D_Text* text, C2D_Font font, C2D_TextArena arena, const char* str, u32 flags)
+{
+	const char* end;
+	if (arena->numChunks)
+	{
+		// Try the current chunk first, and undo the parse if the string didn't fit in it
+		C2D_TextBuf buf = arena->chunks[arena->numChunks-1];
+		size_t oldCount = buf->glyphCount;
+		end = C2D_TextFontParseEx(text, font, buf, str, flags);
+		if (!*end)
+			return end;
+		buf->glyphCount = oldCount;
+	}
+
+	// Chunks double in size, and every glyph comes from at least one byte of the string, so the new chunk always fits it
+	size_t len = strlen(str);
+	size_t size = arena->numChunks ? 2*arena->chunks[arena->numChunks-1]->glyphBufSize : arena->chunkGlyphs;
+	if (size < len)
+		size = len;
+	if (!C2Di_ArrayReserve((void**)&arena->chunks, &arena->chunkCap, arena->numChunks+1, sizeof(C2D_TextBuf)))
+		return NULL;
+	C2D_TextBuf buf = C2D_TextBufNew(size);
+	if (!buf)
+		return NULL;
+	arena->chunks[arena->numChunks++] = buf;
+	return C2D_TextFontParseEx(text, font, buf, str, flags);
+}
+
+const char* C2D_TextUpdate(C2D_Text* text, const char* str)
+{
+	C2D_TextBuf buf = text->buf;
+	size_t len = strlen(str);
+	C2Di_TextSource** srcLink = C2Di_TextSourceFind(buf, text->begin);
+	C2Di_TextSource* src = *srcLink;
+
+	// Discard history that doesn't describe the text object as it currently is
+	if (src && (src->end != text->end || src->font != text->font))
+	{
+		*srcLink = src->next;
+		C2Di_TextSourceFree(src);
+		src = NULL;
+	}
+
+	if (!src)
+	{
+		src = (C2Di_TextSource*)calloc(1, sizeof(C2Di_TextSource));
+		if (!src)
+			return C2D_TextFontParse(text, text->font, buf, str);
+		src->font   = text->font;
+		src->begin  = text->begin;
+		src->limit  = text->end;
+		src->markup = text->end != text->begin && (buf->glyphs[text->begin].flags & C2Di_GLYPH_MARKUP);
+		src->next  = buf->sources;
+		buf->sources = src;
+	}
+	else if (src->strLen == len && memcmp(src->str, str, len) == 0)
+		return str + src->stopPos; // Nothing changed
+
+	C2Di_ParseState st;
+	C2Di_ParseStateInit(&st, text->font, buf, 0);
+	st.markup  = src->markup;
+	st.src     = src;
+	st.srcBase = (const uint8_t*)str;
+
+	// Find the last glyph produced entirely by the unchanged prefix of the string
+	size_t numGlyphs = 0, resumePos = 0;
+	if (src->str)
+	{
+		size_t common = 0;
+		while (common < src->strLen && common < len && src->str[common] == str[common])
+			common++;
+
+		size_t lo = 0, hi = text->end - text->begin;
+		while (lo < hi)
+		{
+			size_t mid = (lo + hi) / 2;
+			if (src->glyphs[mid].srcEnd <= common)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		numGlyphs = lo;
+	}
+
+	text->width = 0.0f;
+	text->words = 0;
+	text->lines = 0;
+	if (numGlyphs)
+	{
+		// Resume right after that glyph, restoring the parser state at that point
+		C2Di_Glyph* last = &buf->glyphs[text->begin + numGlyphs - 1];
+		u32 i;
+		for (i = 0; i < last->lineNo; i ++)
+		{
+			text->words += src->lines[i].words;
+			if (src->lines[i].width > text->width)
+				text->width = src->lines[i].width;
+		}
+		st.lineNo            = last->lineNo;
+		st.wordNum           = last->wordNo;
+		st.width             = src->glyphs[numGlyphs-1].penEnd;
+		st.lastWasWhitespace = false;
+		st.color             = last->color;
+		resumePos            = src->glyphs[numGlyphs-1].srcEnd;
+	}
+
+	// Remember the new string
+	if (!C2Di_ArrayReserve((void**)&src->str, &src->strCap, len + 1, 1))
+	{
+		C2Di_TextSourceDrop(buf, text->begin);
+		buf->glyphCount = text->end == buf->glyphCount ? text->begin : buf->glyphCount;
+		return C2D_TextFontParse(text, text->font, buf, str);
+	}
+	memcpy(src->str, str, len + 1);
+	src->strLen = len;
+
+	// The last text object in the buffer is free to grow, others must stay within their range
+	bool isLast = text->end == buf->glyphCount;
+	size_t oldCount = buf->glyphCount;
+	buf->glyphCount = text->begin + numGlyphs;
+	if (!isLast)
+		st.limit = src->limit;
+
+	const uint8_t* p = C2Di_ParseText(text, &st, (const uint8_t*)str + resumePos);
+
+	if (isLast)
+		src->limit = text->end;
+	else
+		buf->glyphCount = oldCount;
+	if (src->markup && text->end != text->begin)
+		buf->glyphs[text->begin].flags |= C2Di_GLYPH_MARKUP;
+
+	if (st.src)
+	{
+		src->end = text->end;
+		src->stopPos = p - (const uint8_t*)str;
+	} else
+		C2Di_TextSourceDrop(buf, text->begin); // Out of memory, don't trust the history
+
+	return (const char*)p;
+}
+
+static size_t C2Di_TextSheets(const C2D_Text* text, C3D_Tex** sheets)
+{
+	if (text->font)
+	{
+		if (sheets)
+			*sheets = text->font->glyphSheets;
+		return text->font->cfnt->finf.tglp->nSheets;
+	} else
+	{
+		if (sheets)
+			*sheets = s_glyphSheets;
+		return fontGetGlyphInfo(fontGetSystemFont())->nSheets;
+	}
+}
+
+void C2D_TextOptimize(const C2D_Text* text)
+{
+	C2D_TextBuf buf = text->buf;
+	size_t numGlyphs = text->end - text->begin;
+	if (numGlyphs < 2)
+		return;
+
+	// Glyphs are reordered, so they no longer match the parse history or the line order
+	if (buf->sources)
+		C2Di_TextSourceDrop(buf, text->begin);
+
+	size_t numSheets = C2Di_TextSheets(text, NULL);
+	C2Di_Glyph* glyphs = &buf->glyphs[text->begin];
+	size_t i;
+	u8 textFlags = glyphs[0].flags | C2Di_GLYPH_REORDERED; // Moved to the new first glyph
+	glyphs[0].flags = 0;
+
+	// Without memory for the counting sort, fall back to an insertion sort, which needs none
+	size_t scratchSize = numGlyphs*sizeof(C2Di_Glyph) + (numSheets+1)*sizeof(u32);
+	if (!C2Di_ArrayReserve(&buf->scratch, &buf->scratchSize, scratchSize, 1))
+	{
+		for (i = 1; i < numGlyphs; i ++)
+		{
+			C2Di_Glyph glyph = glyphs[i];
+			size_t j = i;
+			while (j > 0 && glyphs[j-1].sheet > glyph.sheet)
+				j--;
+			if (j == i)
+				continue;
+			memmove(&glyphs[j+1], &glyphs[j], (i-j)*sizeof(C2Di_Glyph));
+			glyphs[j] = glyph;
+		}
+		glyphs[0].flags = textFlags;
+		return;
+	}
+
+	// Counting sort by sheet index, which keeps glyphs of the same sheet in parse order
+	C2Di_Glyph* temp = (C2Di_Glyph*)buf->scratch;
+	u32* offsets = (u32*)&temp[numGlyphs];
+	memset(offsets, 0, (numSheets+1)*sizeof(u32));
+
+	for (i = 0; i < numGlyphs; i ++)
+		offsets[glyphs[i].sheet + 1]++;
+	for (i = 1; i < numSheets; i ++)
+		offsets[i] += offsets[i-1];
+	for (i = 0; i < numGlyphs; i ++)
+		temp[offsets[glyphs[i].sheet]++] = glyphs[i];
+
+	memcpy(glyphs, temp, numGlyphs*sizeof(C2Di_Glyph));
+	glyphs[0].flags = textFlags;
+}
+
+void C2D_TextGetDimensions(const C2D_Text* text, float scaleX, float scaleY, float* outWidth, float* outHeight)
+{
+	if (outWidth)
+		*outWidth  = scaleX*text->width;
+	if (outHeight)
+	{
+		if (text->font)
+			*outHeight = ceilf(scaleY*text->font->textScale*text->font->cfnt->finf.lineFeed)*text->lines;
+		else
+			*outHeight = ceilf(scaleY*s_textScale*fontGetInfo(fontGetSystemFont())->lineFeed)*text->lines;
+	}
+}
+
+static inline void C2Di_CalcLineInfo(const C2D_Text* text, C2Di_LineInfo* lines, C2Di_WordInfo* words)
+{
+	C2Di_Glyph* begin = &text->buf->glyphs[text->begin];
+	C2Di_Glyph* end   = &text->buf->glyphs[text->end];
+	C2Di_Glyph* cur;
+	// Get information about lines
+	memset(lines, 0, sizeof(C2Di_LineInfo) * text->lines);
+	for (cur = begin; cur != end; cur++)
+		if (cur->wordNo >= lines[cur->lineNo].words)
+			lines[cur->lineNo].words = cur->wordNo + 1;
+	for (u32 i = 1; i < text->lines; i++)
+		lines[i].wordStart = lines[i-1].wordStart + lines[i-1].words;
+
+	// Get information about words
+	for (u32 i = 0; i < text->words; i++)
+	{
+		words[i].start = NULL;
+		words[i].end = NULL;
+		words[i].wrapXOffset = 0;
+		words[i].newLineNumber = 0;
+	}
+	for (cur = begin; cur != end; cur++)
+	{
+		u32 consecutiveWordNum = cur->wordNo + lines[cur->lineNo].wordStart;
+		if (!words[consecutiveWordNum].end || cur->xPos + cur->width > words[consecutiveWordNum].end->xPos + words[consecutiveWordNum].end->width)
+			words[consecutiveWordNum].end = cur;
+		if (!words[consecutiveWordNum].start || cur->xPos < words[consecutiveWordNum].start->xPos)
+			words[consecutiveWordNum].start = cur;
+		words[consecutiveWordNum].newLineNumber = cur->lineNo;
+	}
+}
+
+// Without words (and so without wrapping), only the widths of numWidths lines starting at firstLine are calculated
+static inline void C2Di_CalcLineWidths(float* widths, const C2D_Text* text, const C2Di_WordInfo* words, bool wrap, u32 firstLine, u32 numWidths)
+{
+	u32 currentWord = 0;
+	if (words)
+	{
+		while (currentWord != text->words)
+		{
+			u32 nextLineWord = currentWord + 1;
+			// Advance nextLineWord to the next word that's on a different line, or the end
+			if (wrap)
+			{
+				while (nextLineWord != text->words && words[nextLineWord].newLineNumber == words[currentWord].newLineNumber) nextLineWord++;
+				// Finally, set the new line width
+				widths[words[currentWord].newLineNumber] = words[nextLineWord-1].end->xPos + words[nextLineWord-1].end->width - words[currentWord].start->xPos;
+			}
+			else
+			{
+				while (nextLineWord != text->words && words[nextLineWord].start->lineNo == words[currentWord].start->lineNo) nextLineWord++;
+				// Finally, set the new line width
+				widths[words[currentWord].start->lineNo] = words[nextLineWord-1].end->xPos + words[nextLineWord-1].end->width - words[currentWord].start->xPos;
+			}
+
+			currentWord = nextLineWord;
+		}
+	}
+	else
+	{
+		memset(widths, 0, sizeof(float) * numWidths);
+		for (C2Di_Glyph* cur = &text->buf->glyphs[text->begin]; cur != &text->buf->glyphs[text->end]; cur++)
+		{
+			u32 line = cur->lineNo - firstLine;
+			if (line < numWidths && cur->xPos + cur->width > widths[line])
+				widths[line] = cur->xPos + cur->width;
+		}
+	}
+}
+
+typedef struct C2Di_JustifiedLineInfo_s
+{
+	float whitespaceWidth;
+	u32 wordStart;
+	u32 words;
+} C2Di_JustifiedLineInfo;
+
+typedef struct C2Di_WordPosition_s
+{
+	float xBegin;
+	float xEnd;
+} C2Di_WordPosition;
+
+// Everything needed to place the glyphs of a text object according to the alignment/wrapping flags
+typedef struct C2Di_TextLayoutInfo_s
+{
+	u32 flags;
+	float scaleX;
+	float dispY;
+	float maxWidth;
+	u32 numLines; // Number of lines after wrapping
+	C2Di_WordInfo* words;
+	C2Di_LineInfo* lines;
+	float* lineWidths; // Starting at line widthLine
+	u32 widthLine;
+	C2Di_JustifiedLineInfo* justifiedLines;
+	C2Di_WordPosition* wordPositions;
+} C2Di_TextLayoutInfo;
+
+static void C2Di_TextMetrics(const C2D_Text* text, float* scaleX, float* scaleY, float* glyphH, float* dispY, float* baseline)
+{
+	if (text->font)
+	{
+		*scaleX *= text->font->textScale;
+		*scaleY *= text->font->textScale;
+		*glyphH   = *scaleY*text->font->cfnt->finf.tglp->cellHeight;
+		*dispY    = ceilf(*scaleY*text->font->cfnt->finf.lineFeed);
+		*baseline = *scaleY*text->font->cfnt->finf.tglp->baselinePos;
+	} else
+	{
+		CFNT_s* systemFont = fontGetSystemFont();
+		*scaleX *= s_textScale;
+		*scaleY *= s_textScale;
+		*glyphH   = *scaleY*fontGetGlyphInfo(systemFont)->cellHeight;
+		*dispY    = ceilf(*scaleY*fontGetInfo(systemFont)->lineFeed);
+		*baseline = *scaleY*fontGetGlyphInfo(systemFont)->baselinePos;
+	}
+}
+
+static inline u32 C2Di_TextMaxLines(const C2D_Text* text, u32 flags)
+{
+	// Wrapping can at most put every word on its own line
+	return (flags & C2D_WordWrap) ? text->lines + text->words : text->lines;
+}
+
+// Lines whose widths are needed for right or center alignment: all of them when wrapping, since wrapped lines
+// are only known once the whole text is laid out, otherwise only those in the given range
+static inline void C2Di_TextWidthLines(const C2D_Text* text, u32 flags, u32* firstLine, u32* numLines)
+{
+	if (flags & C2D_WordWrap)
+	{
+		*firstLine = 0;
+		*numLines  = C2Di_TextMaxLines(text, flags);
+		return;
+	}
+	if (*firstLine > text->lines)
+		*firstLine = text->lines;
+	if (*numLines > text->lines - *firstLine)
+		*numLines = text->lines - *firstLine;
+}
+
+// Memory needed by C2Di_TextLayoutInfoInit to lay out lines firstLine to firstLine+numLines-1 of a text
+static size_t C2Di_TextLayoutInfoSize(const C2D_Text* text, u32 flags, u32 firstLine, u32 numLines)
+{
+	size_t size = 0;
+	if ((flags & C2D_WordWrap) || (flags & C2D_AlignMask) == C2D_AlignJustified)
+		size += sizeof(C2Di_WordInfo)*text->words + sizeof(C2Di_LineInfo)*text->lines;
+	switch (flags & C2D_AlignMask)
+	{
+		case C2D_AlignRight:
+		case C2D_AlignCenter:
+			C2Di_TextWidthLines(text, flags, &firstLine, &numLines);
+			size += sizeof(float)*numLines;
+			break;
+		case C2D_AlignJustified:
+			size += sizeof(C2Di_JustifiedLineInfo)*C2Di_TextMaxLines(text, flags) + sizeof(C2Di_WordPosition)*text->words;
+			break;
+	}
+	return size;
+}
+
+static void C2Di_TextLayoutInfoInit(C2Di_TextLayoutInfo* info, const C2D_Text* text, u32 flags, u32 firstLine, u32 numLines, float scaleX, float dispY, float maxWidth, void* mem)
+{
+	u8* p = (u8*)mem;
+	info->flags          = flags;
+	info->scaleX         = scaleX;
+	info->dispY          = dispY;
+	info->maxWidth       = maxWidth;
+	info->numLines       = text->lines;
+	info->words          = NULL;
+	info->lines          = NULL;
+	info->lineWidths     = NULL;
+	info->widthLine      = 0;
+	info->justifiedLines = NULL;
+	info->wordPositions  = NULL;
+
+	C2Di_WordInfo* words = NULL;
+	if ((flags & C2D_WordWrap) || (flags & C2D_AlignMask) == C2D_AlignJustified)
+	{
+		info->words = words = (C2Di_WordInfo*)p;
+		p += sizeof(C2Di_WordInfo)*text->words;
+		info->lines = (C2Di_LineInfo*)p;
+		p += sizeof(C2Di_LineInfo)*text->lines;
+		C2Di_CalcLineInfo(text, info->lines, words);
+	}
+
+	if (flags & C2D_WordWrap)
+	{
+		// The first word will never have a wrap offset in X or Y
+		for (u32 i = 1; i < text->words; i++)
+		{
+			// If the current word was originally on a different line than the last one, only the difference between new line number and original line number should be the same
+			if (words[i-1].start->lineNo != words[i].start->lineNo)
+			{
+				words[i].wrapXOffset = 0;
+				words[i].newLineNumber = words[i].start->lineNo + (words[i-1].newLineNumber - words[i-1].start->lineNo);
+			}
+			// Otherwise, if the current word goes over the width, with the previous word's offset taken into account...
+			else if (scaleX*(words[i-1].wrapXOffset + words[i].end->xPos + words[i].end->width) > maxWidth)
 			{
 				// Then set the X offset to the negative of the original position
 				words[i].wrapXOffset = -words[i].start->xPos;
@@ -389,176 +1588,825 @@ void C2D_DrawText(const C2D_Text* text, u32 flags, float x, float y, float z, fl
 			// Otherwise both X offset and new line number should be the same as the last word's
 			else
 			{
-				words[i].wrapXOffset = words[i-1].wrapXOffset;
-				words[i].newLineNumber = words[i-1].newLineNumber;
+				words[i].wrapXOffset = words[i-1].wrapXOffset;
+				words[i].newLineNumber = words[i-1].newLineNumber;
+			}
+		}
+
+		// Account for the lines added by wrapping (trailing empty lines are kept as is)
+		if (text->words)
+			info->numLines += words[text->words-1].newLineNumber - words[text->words-1].start->lineNo;
+	}
+
+	switch (flags & C2D_AlignMask)
+	{
+		case C2D_AlignRight:
+		case C2D_AlignCenter:
+		{
+			C2Di_TextWidthLines(text, flags, &firstLine, &numLines);
+			info->lineWidths = (float*)p;
+			info->widthLine  = firstLine;
+			C2Di_CalcLineWidths(info->lineWidths, text, words, flags & C2D_WordWrap, firstLine, numLines);
+			break;
+		}
+		case C2D_AlignJustified:
+		{
+			// Get total width available for whitespace for all lines after wrapping
+			u32 numLines = words[text->words - 1].newLineNumber + 1;
+			C2Di_JustifiedLineInfo* justifiedLineInfo = info->justifiedLines = (C2Di_JustifiedLineInfo*)p;
+			p += sizeof(C2Di_JustifiedLineInfo)*C2Di_TextMaxLines(text, flags);
+			for (u32 i = 0; i < numLines; i++)
+			{
+				justifiedLineInfo[i].whitespaceWidth = 0;
+				justifiedLineInfo[i].words = 0;
+				justifiedLineInfo[i].wordStart = 0;
+			}
+			for (u32 i = 0; i < text->words; i++)
+			{
+				// Calculate the total text width
+				justifiedLineInfo[words[i].newLineNumber].whitespaceWidth += words[i].end->xPos + words[i].end->width - words[i].start->xPos;
+				// Increment amount of words
+				justifiedLineInfo[words[i].newLineNumber].words++;
+				// And set the word starts
+				if (i > 0 && words[i-1].newLineNumber != words[i].newLineNumber)
+					justifiedLineInfo[words[i].newLineNumber].wordStart = i;
+			}
+			for (u32 i = 0; i < numLines; i++)
+			{
+				// Transform it from total text width to total whitespace width
+				justifiedLineInfo[i].whitespaceWidth = maxWidth - scaleX*justifiedLineInfo[i].whitespaceWidth;
+				// And then get the width of a single whitespace
+				if (justifiedLineInfo[i].words > 1)
+					justifiedLineInfo[i].whitespaceWidth /= justifiedLineInfo[i].words - 1;
+			}
+
+			// Set up final word beginnings and ends
+			C2Di_WordPosition* wordPositions = info->wordPositions = (C2Di_WordPosition*)p;
+			wordPositions[0].xBegin = 0;
+			wordPositions[0].xEnd = wordPositions[0].xBegin + words[0].end->xPos + words[0].end->width - words[0].start->xPos;
+			for (u32 i = 1; i < text->words; i++)
+			{
+				wordPositions[i].xBegin = words[i-1].newLineNumber != words[i].newLineNumber ? 0 : wordPositions[i-1].xEnd;
+				wordPositions[i].xEnd = wordPositions[i].xBegin + words[i].end->xPos + words[i].end->width - words[i].start->xPos;
+			}
+			break;
+		}
+	}
+}
+
+// Calculates the position of a glyph relative to the origin of the text
+static inline void C2Di_TextLayoutGlyph(const C2Di_TextLayoutInfo* info, const C2Di_Glyph* cur, float* outX, float* outY)
+{
+	float scaleX = info->scaleX;
+	if ((info->flags & C2D_AlignMask) == C2D_AlignJustified)
+	{
+		u32 consecutiveWordNum = cur->wordNo + info->lines[cur->lineNo].wordStart;
+		const C2Di_WordInfo* word = &info->words[consecutiveWordNum];
+		const C2Di_JustifiedLineInfo* line = &info->justifiedLines[word->newLineNumber];
+		// The scaled beginning position for this word, plus the offset of this glyph within the word, plus the whitespace width for this line times the word number within the line
+		*outX = scaleX*info->wordPositions[consecutiveWordNum].xBegin + scaleX*(cur->xPos - word->start->xPos) + line->whitespaceWidth*(consecutiveWordNum - line->wordStart);
+		*outY = info->dispY*word->newLineNumber;
+		return;
+	}
+
+	float xPos = cur->xPos;
+	u32 lineNo = cur->lineNo;
+	if (info->flags & C2D_WordWrap)
+	{
+		const C2Di_WordInfo* word = &info->words[cur->wordNo + info->lines[cur->lineNo].wordStart];
+		xPos += word->wrapXOffset;
+		lineNo = word->newLineNumber;
+	}
+
+	switch (info->flags & C2D_AlignMask)
+	{
+		case C2D_AlignRight:
+			xPos -= info->lineWidths[lineNo - info->widthLine];
+			break;
+		case C2D_AlignCenter:
+			xPos -= info->lineWidths[lineNo - info->widthLine]/2;
+			break;
+	}
+
+	*outX = scaleX*xPos;
+	*outY = info->dispY*lineNo;
+}
+
+// Returns the line a glyph is placed on, after wrapping
+static inline u32 C2Di_TextLayoutLine(const C2Di_TextLayoutInfo* info, const C2Di_Glyph* cur)
+{
+	if (info->words)
+		return info->words[cur->wordNo + info->lines[cur->lineNo].wordStart].newLineNumber;
+	return cur->lineNo;
+}
+
+// Finds the first glyph on or after the given line, in a range of glyphs that are in line order
+static const C2Di_Glyph* C2Di_FindLine(const C2Di_Glyph* begin, const C2Di_Glyph* end, u32 lineNo)
+{
+	while (begin != end)
+	{
+		const C2Di_Glyph* mid = begin + (end - begin)/2;
+		if (mid->lineNo < lineNo)
+			begin = mid + 1;
+		else
+			end = mid;
+	}
+	return begin;
+}
+
+static inline void C2Di_SetVtx(C2Di_Vertex* vtx, float x, float y, float z, float u, float v, u32 color)
+{
+	vtx->pos[0]      = x;
+	vtx->pos[1]      = y;
+	vtx->pos[2]      = z;
+	vtx->texcoord[0] = u;
+	vtx->texcoord[1] = v;
+	vtx->ptcoord[0]  = 0.0f;
+	vtx->ptcoord[1]  = 1.0f;
+	vtx->color       = color;
+}
+
+static inline void C2Di_SetGlyphQuad(C2Di_Vertex* vtx, const C2Di_Texcoord* tc, float x, float y, float z, float w, float h, u32 color)
+{
+	C2Di_SetVtx(&vtx[0], x,   y,   z, tc->left,  tc->top,    color);
+	C2Di_SetVtx(&vtx[1], x+w, y,   z, tc->right, tc->top,    color);
+	C2Di_SetVtx(&vtx[2], x,   y+h, z, tc->left,  tc->bottom, color);
+	C2Di_SetVtx(&vtx[3], x+w, y+h, z, tc->right, tc->bottom, color);
+}
+
+// Looks up the texture coordinates of a glyph in the table of its sheet, or calculates them if there is no table
+static inline const C2Di_Texcoord* C2Di_GlyphTexcoord(C2D_Font font, const C2Di_Texcoord* texcoords, const C2Di_Glyph* glyph, C2Di_Texcoord* temp)
+{
+	if (texcoords)
+		return &texcoords[glyph->sheetGlyph];
+	C2Di_FontCalcTexcoord(font, glyph->sheet, glyph->sheetGlyph, temp);
+	return temp;
+}
+
+// Texture state for drawing runs of consecutive glyphs that come from the same texture
+typedef struct C2Di_GlyphRun_s
+{
+	C2D_Font font;
+	C3D_Tex* sheets;
+	bool streamed; // The glyph sheets are loaded on demand
+	bool atlas;    // The glyphs may be in the glyph atlas
+	bool inAtlas;  // The current run is drawn from the atlas...
+	u16 sheet;     // ...or from this glyph sheet
+	const C2Di_Texcoord* texcoords;
+} C2Di_GlyphRun;
+
+static void C2Di_GlyphRunInit(C2Di_GlyphRun* run, const C2D_Text* text)
+{
+	run->font     = text->font;
+	run->streamed = text->font && text->font->stream;
+	run->atlas    = C2Di_AtlasHasFont(text->font);
+	C2Di_TextSheets(text, &run->sheets);
+}
+
+// Makes sure the texture of a glyph is available: its sheet is resident, and it is in the atlas if the text uses it.
+// C2Di_AtlasFlush must be called before drawing. Returns false if the sheet could not be loaded.
+static inline bool C2Di_GlyphRunPrepare(const C2Di_GlyphRun* run, const C2Di_Glyph* glyph)
+{
+	if (run->streamed && !C2Di_FontLoadSheet(run->font, glyph->sheet))
+		return false;
+	if (run->atlas)
+		C2Di_AtlasAdd(glyph->sheet, glyph->sheetGlyph);
+	return true;
+}
+
+static inline bool C2Di_GlyphRunMatches(const C2Di_GlyphRun* run, const C2Di_Glyph* glyph)
+{
+	bool inAtlas = run->atlas && C2Di_AtlasFind(glyph->sheet, glyph->sheetGlyph);
+	return inAtlas == run->inAtlas && (inAtlas || glyph->sheet == run->sheet);
+}
+
+// Starts a new run with the given glyph, binding its texture
+static void C2Di_GlyphRunStart(C2Di_GlyphRun* run, const C2Di_Glyph* glyph)
+{
+	run->inAtlas = run->atlas && C2Di_AtlasFind(glyph->sheet, glyph->sheetGlyph);
+	run->sheet   = glyph->sheet;
+	if (run->inAtlas)
+	{
+		run->texcoords = NULL;
+		C2Di_SetTex(C2Di_AtlasGetTex());
+	} else
+	{
+		run->texcoords = C2Di_FontGetSheetTexcoords(run->font, glyph->sheet);
+		C2Di_SetTex(&run->sheets[glyph->sheet]);
+	}
+	C2Di_Update();
+}
+
+static inline const C2Di_Texcoord* C2Di_GlyphRunTexcoord(const C2Di_GlyphRun* run, const C2Di_Glyph* glyph, C2Di_Texcoord* temp)
+{
+	if (run->inAtlas)
+		return C2Di_AtlasFind(glyph->sheet, glyph->sheetGlyph);
+	return C2Di_GlyphTexcoord(run->font, run->texcoords, glyph, temp);
+}
+
+static inline u32 C2Di_TextMode(C2D_Font font)
+{
+	return font && font->distanceField ? C2DiF_Mode_TextSdf : C2DiF_Mode_Text;
+}
+
+// Checks that the whole text fits in the vertex buffer before anything is emitted
+static bool C2Di_TextBeginDraw(const C2D_Text* text, size_t numGlyphs)
+{
+	C2Di_Context* ctx = C2Di_GetContext();
+	if (!(ctx->flags & C2DiF_Active))
+		return false;
+	if (!C2Di_CheckBufSpace(ctx, 6*numGlyphs, 4*numGlyphs))
+		return false;
+
+	C2Di_SetMode(C2Di_TextMode(text->font));
+	return true;
+}
+
+#define C2Di_MAX_TEXT_LAYERS 10 // Shadow, outline and the text itself
+
+// Offset copy of the glyphs of a text, drawn in order from the first layer to the last
+typedef struct
+{
+	float dx, dy;
+	u32 color;
+	bool markup; // Glyphs with a color set by markup use it instead
+} C2Di_TextLayer;
+
+// Directions of the copies that make up an outline
+static const float s_outlineDirs[8][2] =
+{
+	{ -1.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, -1.0f }, { 0.0f, 1.0f },
+	{ -0.7071068f, -0.7071068f }, { 0.7071068f, -0.7071068f }, { -0.7071068f, 0.7071068f }, { 0.7071068f, 0.7071068f },
+};
+
+static inline void C2Di_AddTextLayer(C2Di_TextLayer* layers, size_t* numLayers, float dx, float dy, u32 color, bool markup)
+{
+	C2Di_TextLayer* layer = &layers[(*numLayers)++];
+	layer->dx     = dx;
+	layer->dy     = dy;
+	layer->color  = color;
+	layer->markup = markup;
+}
+
+// Reads the arguments of C2D_WithShadow and C2D_WithOutline, which follow the wrap width. The va_list is passed by
+// pointer so that the caller can read the arguments after them.
+static void C2Di_ReadTextLayers(C2Di_TextLayer* layers, size_t* numLayers, u32 flags, u32 color, va_list* va)
+{
+	if (flags & C2D_WithShadow)
+	{
+		u32 shadowColor = va_arg(*va, u32);
+		float dx = va_arg(*va, double);
+		float dy = va_arg(*va, double);
+		C2Di_AddTextLayer(layers, numLayers, dx, dy, shadowColor, false);
+	}
+	if (flags & C2D_WithOutline)
+	{
+		u32 outlineColor = va_arg(*va, u32);
+		float thickness = va_arg(*va, double);
+		size_t i;
+		for (i = 0; i < 8; i ++)
+			C2Di_AddTextLayer(layers, numLayers, thickness*s_outlineDirs[i][0], thickness*s_outlineDirs[i][1], outlineColor, false);
+	}
+	C2Di_AddTextLayer(layers, numLayers, 0.0f, 0.0f, color, true);
+}
+
+// Decides which glyphs are drawn: those in a range of lines that may overlap the clip rectangle, if any
+typedef struct
+{
+	const C2Di_TextLayoutInfo* info;
+	u32 firstLine;
+	u32 numLines;
+	bool cull;
+	float left, top, right, bottom; // Relative to the position of the text, grown by the offsets of the layers
+	float glyphH;
+} C2Di_GlyphFilter;
+
+static inline bool C2Di_GlyphFilterPass(const C2Di_GlyphFilter* filter, const C2Di_Glyph* cur)
+{
+	if (C2Di_TextLayoutLine(filter->info, cur) - filter->firstLine >= filter->numLines)
+		return false;
+	if (!filter->cull)
+		return true;
+
+	float glyphX, glyphY;
+	C2Di_TextLayoutGlyph(filter->info, cur, &glyphX, &glyphY);
+	float glyphW = filter->info->scaleX*cur->width;
+	float glyphH = filter->glyphH;
+	// Negative scales mirror the glyphs
+	float left = glyphW < 0.0f ? glyphX + glyphW : glyphX, top = glyphH < 0.0f ? glyphY + glyphH : glyphY;
+	return left < filter->right && left + fabsf(glyphW) > filter->left && top < filter->bottom && top + fabsf(glyphH) > filter->top;
+}
+
+// Moves a coordinate of every vertex of a glyph quad into a range, adjusting its texture coordinate to match
+static inline void C2Di_ClipGlyphQuadAxis(C2Di_Vertex* vtx, int axis, int other, float min, float max)
+{
+	float p0 = vtx[0].pos[axis], p1 = vtx[other].pos[axis];
+	float t0 = vtx[0].texcoord[axis], t1 = vtx[other].texcoord[axis];
+	int i;
+	for (i = 0; i < 4; i ++)
+	{
+		float p = vtx[i].pos[axis];
+		if (p >= min && p <= max)
+			continue;
+		p = p < min ? min : max;
+		vtx[i].pos[axis] = p;
+		if (p1 != p0)
+			vtx[i].texcoord[axis] = t0 + (t1 - t0)*(p - p0)/(p1 - p0);
+	}
+}
+
+#define C2Di_LAYOUT_STACK_MAX 2048 // Larger layouts are allocated on the heap, thread stacks are small on the 3DS
+
+static bool C2Di_DrawTextLines(const C2D_Text* text, u32 flags, u32 firstLine, u32 numLines, float x, float y, float z, float scaleX, float scaleY, va_list* va)
+{
+	// If there are no words, we can't do the math calculations necessary with them. Just return; nothing would be drawn anyway.
+	if (text->words == 0)
+		return true;
+	const C2Di_Glyph* begin = &text->buf->glyphs[text->begin];
+	const C2Di_Glyph* end   = &text->buf->glyphs[text->end];
+	const C2Di_Glyph* cur;
+	if (numLines > UINT32_MAX - firstLine)
+		numLines = UINT32_MAX - firstLine; // So that lines before firstLine are outside of the range (see C2Di_GlyphFilterPass)
+
+	float glyphZ = z;
+	float glyphH;
+	float dispY;
+	float baseline;
+	C2Di_TextMetrics(text, &scaleX, &scaleY, &glyphH, &dispY, &baseline);
+	u32 color = 0xFF000000;
+	float maxWidth = scaleX*text->width;
+	C2Di_TextLayer layers[C2Di_MAX_TEXT_LAYERS];
+	size_t numLayers = 0;
+
+	if (flags & C2D_AtBaseline)
+		y -= baseline;
+	if (flags & C2D_WithColor)
+		color = va_arg(*va, u32);
+	if (flags & C2D_WordWrap)
+		maxWidth = va_arg(*va, double); // Passed as float, but varargs promotes to double.
+	C2Di_ReadTextLayers(layers, &numLayers, flags, color, va);
+
+	float clipLeft = 0.0f, clipTop = 0.0f, clipRight = 0.0f, clipBottom = 0.0f;
+	if (flags & C2D_WithClip)
+	{
+		clipLeft   = va_arg(*va, double);
+		clipTop    = va_arg(*va, double);
+		clipRight  = clipLeft + va_arg(*va, double);
+		clipBottom = clipTop + va_arg(*va, double);
+	}
+
+	// Without wrapping, lines are the same as in the text object, so the glyphs outside the range can be skipped
+	// right away (and right/center alignment only has to look at the lines that are drawn, see C2Di_TextWidthLines)
+	C2D_Text visible = *text;
+	bool reordered = begin != end && (begin->flags & C2Di_GLYPH_REORDERED);
+	if (!reordered && !(flags & C2D_WordWrap) && (flags & C2D_AlignMask) != C2D_AlignJustified)
+	{
+		begin = C2Di_FindLine(begin, end, firstLine);
+		end   = C2Di_FindLine(begin, end, firstLine + numLines);
+		visible.begin = begin - text->buf->glyphs;
+		visible.end   = end - text->buf->glyphs;
+	}
+
+	// Wrapping and justification need the whole text, which may take too much memory for the stack
+	size_t layoutSize = C2Di_TextLayoutInfoSize(text, flags, firstLine, numLines);
+	void* layoutHeap = NULL;
+	if (layoutSize > C2Di_LAYOUT_STACK_MAX && !(layoutHeap = malloc(layoutSize)))
+		return false;
+	C2Di_TextLayoutInfo info;
+	C2Di_TextLayoutInfoInit(&info, &visible, flags, firstLine, numLines, scaleX, dispY, maxWidth, layoutHeap ? layoutHeap : alloca(layoutSize));
+
+	C2Di_GlyphFilter filter;
+	filter.info      = &info;
+	filter.firstLine = firstLine;
+	filter.numLines  = numLines;
+	filter.cull      = (flags & C2D_WithClip) != 0;
+	filter.glyphH    = glyphH;
+	filter.left      = filter.top = filter.right = filter.bottom = 0.0f; // Only read when culling
+	if (filter.cull)
+	{
+		// Glyphs are culled if none of their layers overlap the clip rectangle, and clipped after drawing
+		float minDx = 0.0f, maxDx = 0.0f, minDy = 0.0f, maxDy = 0.0f;
+		size_t i;
+		for (i = 0; i < numLayers; i ++)
+		{
+			minDx = fminf(minDx, layers[i].dx);
+			maxDx = fmaxf(maxDx, layers[i].dx);
+			minDy = fminf(minDy, layers[i].dy);
+			maxDy = fmaxf(maxDy, layers[i].dy);
+		}
+		filter.left   = clipLeft - x - maxDx;
+		filter.top    = clipTop - y - maxDy;
+		filter.right  = clipRight - x - minDx;
+		filter.bottom = clipBottom - y - minDy;
+	}
+
+	C2Di_GlyphRun run;
+	C2Di_GlyphRunInit(&run, text);
+
+	size_t numGlyphs = 0;
+	for (cur = begin; cur != end; ++cur)
+		if (C2Di_GlyphFilterPass(&filter, cur))
+		{
+			if (!C2Di_GlyphRunPrepare(&run, cur))
+			{
+				free(layoutHeap);
+				return false;
 			}
+			numGlyphs++;
 		}
+	if (!C2Di_TextBeginDraw(text, numLayers*numGlyphs))
+	{
+		free(layoutHeap);
+		return false;
 	}
+	if (run.atlas)
+		C2Di_AtlasFlush();
 
-	switch (flags & C2D_AlignMask)
+	// Every layer of a run is drawn before the next run, back to front, so each texture is bound once no matter
+	// how many layers there are. Only the first layer is laid out, the others are copied from its quads.
+	C2Di_Vertex* firstQuads = NULL;
+	for (cur = begin; cur != end;)
 	{
-		case C2D_AlignLeft:
-			for (cur = begin; cur != end; ++cur)
-			{
-				float glyphW = scaleX*cur->width;
-				float glyphX;
-				float glyphY;
-				if (flags & C2D_WordWrap)
-				{
-					u32 consecutiveWordNum = cur->wordNo + lines[cur->lineNo].wordStart;
-					glyphX = x+scaleX*(cur->xPos + words[consecutiveWordNum].wrapXOffset);
-					glyphY = y+dispY*words[consecutiveWordNum].newLineNumber;
-				}
-				else
-				{
-					glyphX = x+scaleX*cur->xPos;
-					glyphY = y+dispY*cur->lineNo;
-				}
+		if (!C2Di_GlyphFilterPass(&filter, cur))
+		{
+			++cur;
+			continue;
+		}
 
-				C2Di_SetTex(cur->sheet);
-				C2Di_Update();
-				C2Di_AppendQuad();
-				C2Di_AppendVtx(glyphX,        glyphY,        glyphZ, cur->texcoord.left,  cur->texcoord.top,    0.0f, 1.0f, color);
-				C2Di_AppendVtx(glyphX+glyphW, glyphY,        glyphZ, cur->texcoord.right, cur->texcoord.top,    0.0f, 1.0f, color);
-				C2Di_AppendVtx(glyphX,        glyphY+glyphH, glyphZ, cur->texcoord.left,  cur->texcoord.bottom, 0.0f, 1.0f, color);
-				C2Di_AppendVtx(glyphX+glyphW, glyphY+glyphH, glyphZ, cur->texcoord.right, cur->texcoord.bottom, 0.0f, 1.0f, color);
-			}
-			break;
-		case C2D_AlignRight:
+		// Bind the texture once for the whole run, then fill its quads in one go
+		C2Di_GlyphRunStart(&run, cur);
+		const C2Di_Glyph* runEnd = cur + 1;
+		while (runEnd != end && C2Di_GlyphRunMatches(&run, runEnd) && C2Di_GlyphFilterPass(&filter, runEnd))
+			++runEnd;
+
+		size_t count = runEnd - cur;
+		C2Di_Vertex* vtx = C2Di_AppendQuads(numLayers*count);
+		if (!firstQuads)
+			firstQuads = vtx;
+
+		const C2Di_Glyph* g;
+		C2Di_Vertex* dst = vtx;
+		for (g = cur; g != runEnd; ++g, dst += 4)
 		{
-			float finalLineWidths[flags & C2D_WordWrap ? words[text->words-1].newLineNumber + 1 : text->lines];
-			C2Di_CalcLineWidths(finalLineWidths, text, words, flags & C2D_WordWrap);
+			C2Di_Texcoord temp;
+			float glyphX;
+			float glyphY;
+			C2Di_TextLayoutGlyph(&info, g, &glyphX, &glyphY);
+			C2Di_SetGlyphQuad(dst, C2Di_GlyphRunTexcoord(&run, g, &temp), x+layers[0].dx+glyphX, y+layers[0].dy+glyphY, glyphZ, scaleX*g->width, glyphH,
+				layers[0].markup ? C2Di_GlyphColor(text->buf, g, layers[0].color) : layers[0].color);
+		}
 
-			for (cur = begin; cur != end; cur++)
+		size_t layer;
+		for (layer = 1; layer < numLayers; layer ++)
+		{
+			const C2Di_TextLayer* l = &layers[layer];
+			memcpy(dst, vtx, 4*count*sizeof(C2Di_Vertex));
+			for (g = cur; g != runEnd; ++g, dst += 4)
 			{
-				float glyphW = scaleX*cur->width;
-				float glyphX;
-				float glyphY;
-				if (flags & C2D_WordWrap)
-				{
-					u32 consecutiveWordNum = cur->wordNo + lines[cur->lineNo].wordStart;
-					glyphX = x + scaleX*(cur->xPos + words[consecutiveWordNum].wrapXOffset - finalLineWidths[words[consecutiveWordNum].newLineNumber]);
-					glyphY = y + dispY*words[consecutiveWordNum].newLineNumber;
-				}
-				else
+				u32 glyphColor = l->markup ? C2Di_GlyphColor(text->buf, g, l->color) : l->color;
+				size_t i;
+				for (i = 0; i < 4; i ++)
 				{
-					glyphX = x + scaleX*(cur->xPos - finalLineWidths[cur->lineNo]);
-					glyphY = y + dispY*cur->lineNo;
+					dst[i].pos[0] += l->dx - layers[0].dx;
+					dst[i].pos[1] += l->dy - layers[0].dy;
+					dst[i].color   = glyphColor;
 				}
-
-				C2Di_SetTex(cur->sheet);
-				C2Di_Update();
-				C2Di_AppendQuad();
-				C2Di_AppendVtx(glyphX,        glyphY,        glyphZ, cur->texcoord.left,  cur->texcoord.top,    0.0f, 1.0f, color);
-				C2Di_AppendVtx(glyphX+glyphW, glyphY,        glyphZ, cur->texcoord.right, cur->texcoord.top,    0.0f, 1.0f, color);
-				C2Di_AppendVtx(glyphX,        glyphY+glyphH, glyphZ, cur->texcoord.left,  cur->texcoord.bottom, 0.0f, 1.0f, color);
-				C2Di_AppendVtx(glyphX+glyphW, glyphY+glyphH, glyphZ, cur->texcoord.right, cur->texcoord.bottom, 0.0f, 1.0f, color);
 			}
 		}
-		break;
-		case C2D_AlignCenter:
+		cur = runEnd;
+	}
+
+	// Clip the quads of glyphs that straddle the edges, those of layers entirely outside become empty
+	if (flags & C2D_WithClip)
+	{
+		C2Di_Vertex* vtx = firstQuads;
+		size_t i;
+		for (i = 0; i < numLayers*numGlyphs; i ++, vtx += 4)
 		{
-			float finalLineWidths[flags & C2D_WordWrap ? words[text->words-1].newLineNumber + 1 : text->lines];
-			C2Di_CalcLineWidths(finalLineWidths, text, words, flags & C2D_WordWrap);
+			C2Di_ClipGlyphQuadAxis(vtx, 0, 1, clipLeft, clipRight);
+			C2Di_ClipGlyphQuadAxis(vtx, 1, 2, clipTop, clipBottom);
+		}
+	}
+	free(layoutHeap);
+	return true;
+}
 
-			for (cur = begin; cur != end; cur++)
-			{
-				float glyphW = scaleX*cur->width;
-				float glyphX;
-				float glyphY;
-				if (flags & C2D_WordWrap)
-				{
-					u32 consecutiveWordNum = cur->wordNo + lines[cur->lineNo].wordStart;
-					glyphX = x + scaleX*(cur->xPos + words[consecutiveWordNum].wrapXOffset - finalLineWidths[words[consecutiveWordNum].newLineNumber]/2);
-					glyphY = y + dispY*words[consecutiveWordNum].newLineNumber;
-				}
-				else
-				{
-					glyphX = x + scaleX*(cur->xPos - finalLineWidths[cur->lineNo]/2);
-					glyphY = y + dispY*cur->lineNo;
-				}
+bool C2D_DrawText(const C2D_Text* text, u32 flags, float x, float y, float z, float scaleX, float scaleY, ...)
+{
+	va_list va;
+	va_start(va, scaleY);
+	bool ret = C2Di_DrawTextLines(text, flags, 0, UINT32_MAX, x, y, z, scaleX, scaleY, &va);
+	va_end(va);
+	return ret;
+}
 
-				C2Di_SetTex(cur->sheet);
-				C2Di_Update();
-				C2Di_AppendQuad();
-				C2Di_AppendVtx(glyphX,        glyphY,        glyphZ, cur->texcoord.left,  cur->texcoord.top,    0.0f, 1.0f, color);
-				C2Di_AppendVtx(glyphX+glyphW, glyphY,        glyphZ, cur->texcoord.right, cur->texcoord.top,    0.0f, 1.0f, color);
-				C2Di_AppendVtx(glyphX,        glyphY+glyphH, glyphZ, cur->texcoord.left,  cur->texcoord.bottom, 0.0f, 1.0f, color);
-				C2Di_AppendVtx(glyphX+glyphW, glyphY+glyphH, glyphZ, cur->texcoord.right, cur->texcoord.bottom, 0.0f, 1.0f, color);
-			}
+bool C2D_DrawTextLines(const C2D_Text* text, u32 flags, u32 firstLine, u32 numLines, float x, float y, float z, float scaleX, float scaleY, ...)
+{
+	va_list va;
+	va_start(va, scaleY);
+	bool ret = C2Di_DrawTextLines(text, flags, firstLine, numLines, x, y, z, scaleX, scaleY, &va);
+	va_end(va);
+	return ret;
+}
+
+void C2D_TextGetVisibleLines(const C2D_Text* text, u32 flags, float y, float scaleY, float top, float bottom, u32* outFirstLine, u32* outNumLines)
+{
+	float scaleX = 1.0f;
+	float glyphH;
+	float dispY;
+	float baseline;
+	C2Di_TextMetrics(text, &scaleX, &scaleY, &glyphH, &dispY, &baseline);
+	if (flags & C2D_AtBaseline)
+		y -= baseline;
+
+	// Line n covers [y + n*dispY, y + n*dispY + glyphH)
+	float first = floorf((top - y - glyphH)/dispY) + 1.0f;
+	float last  = ceilf((bottom - y)/dispY);
+	if (first < 0.0f)
+		first = 0.0f;
+	if (last <= first)
+	{
+		*outFirstLine = 0;
+		*outNumLines = 0;
+		return;
+	}
+	*outFirstLine = first < (float)UINT32_MAX ? (u32)first : UINT32_MAX;
+	*outNumLines  = last - first < (float)UINT32_MAX ? (u32)(last - first) : UINT32_MAX;
+}
+
+C2D_TextLayout C2D_TextLayoutNew(const C2D_Text* text, u32 flags, float scaleX, float scaleY, float wrapWidth)
+{
+	size_t numGlyphs = text->end - text->begin;
+	C2D_TextLayout layout = (C2D_TextLayout)malloc(sizeof(struct C2D_TextLayout_s) + numGlyphs*sizeof(layout->glyphPos[0]));
+	if (!layout)
+		return NULL;
+
+	float dispY, baseline;
+	C2Di_TextMetrics(text, &scaleX, &scaleY, &layout->glyphH, &dispY, &baseline);
+	layout->text   = *text;
+	layout->scaleX = scaleX;
+	layout->width  = scaleX*text->width;
+	layout->height = dispY*text->lines;
+
+	// There's nothing to lay out without words
+	if (text->words == 0)
+		return layout;
+
+	float maxWidth = (flags & C2D_WordWrap) ? wrapWidth : scaleX*text->width;
+	void* mem = malloc(C2Di_TextLayoutInfoSize(text, flags, 0, UINT32_MAX));
+	if (!mem)
+	{
+		free(layout);
+		return NULL;
+	}
+
+	C2Di_TextLayoutInfo info;
+	C2Di_TextLayoutInfoInit(&info, text, flags, 0, UINT32_MAX, scaleX, dispY, maxWidth, mem);
+
+	float minX = INFINITY, maxX = -INFINITY;
+	size_t i;
+	for (i = 0; i < numGlyphs; i ++)
+	{
+		const C2Di_Glyph* cur = &text->buf->glyphs[text->begin + i];
+		float glyphX, glyphY;
+		C2Di_TextLayoutGlyph(&info, cur, &glyphX, &glyphY);
+		if (flags & C2D_AtBaseline)
+			glyphY -= baseline;
+		layout->glyphPos[i].x = glyphX;
+		layout->glyphPos[i].y = glyphY;
+
+		if (glyphX < minX)
+			minX = glyphX;
+		if (glyphX + scaleX*cur->width > maxX)
+			maxX = glyphX + scaleX*cur->width;
+	}
+
+	// The width of wrapped text is that of its widest line
+	if (flags & C2D_WordWrap)
+	{
+		layout->width  = maxX - minX;
+		layout->height = dispY*info.numLines;
+	}
+
+	free(mem);
+	return layout;
+}
+
+void C2D_TextLayoutDelete(C2D_TextLayout layout)
+{
+	free(layout);
+}
+
+void C2D_TextLayoutGetDimensions(C2D_TextLayout layout, float* outWidth, float* outHeight)
+{
+	if (outWidth)
+		*outWidth  = layout->width;
+	if (outHeight)
+		*outHeight = layout->height;
+}
+
+bool C2D_DrawTextLayout(C2D_TextLayout layout, float x, float y, float z, u32 color)
+{
+	const C2D_Text* text = &layout->text;
+	if (text->words == 0)
+		return true;
+
+	const C2Di_Glyph* begin = &text->buf->glyphs[text->begin];
+	const C2Di_Glyph* end   = &text->buf->glyphs[text->end];
+	const C2Di_Glyph* cur;
+	if (!C2Di_TextBeginDraw(text, end - begin))
+		return false;
+
+	float glyphH = layout->glyphH;
+	size_t i = 0;
+
+	C2Di_GlyphRun run;
+	C2Di_GlyphRunInit(&run, text);
+	if (run.streamed || run.atlas)
+	{
+		for (cur = begin; cur != end; ++cur)
+			if (!C2Di_GlyphRunPrepare(&run, cur))
+				return false;
+		if (run.atlas)
+			C2Di_AtlasFlush();
+	}
+
+	for (cur = begin; cur != end;)
+	{
+		C2Di_GlyphRunStart(&run, cur);
+		const C2Di_Glyph* runEnd = cur + 1;
+		while (runEnd != end && C2Di_GlyphRunMatches(&run, runEnd))
+			++runEnd;
+
+		C2Di_Vertex* vtx = C2Di_AppendQuads(runEnd - cur);
+		for (; cur != runEnd; ++cur, ++i, vtx += 4)
+		{
+			C2Di_Texcoord temp;
+			C2Di_SetGlyphQuad(vtx, C2Di_GlyphRunTexcoord(&run, cur, &temp),
+				x+layout->glyphPos[i].x, y+layout->glyphPos[i].y, z, layout->scaleX*cur->width, glyphH, C2Di_GlyphColor(text->buf, cur, color));
 		}
-		break;
-		case C2D_AlignJustified:
+	}
+	return true;
+}
+
+C2D_BakedText C2D_TextBake(const C2D_Text* text, u32 flags, float scaleX, float scaleY, ...)
+{
+	// The clip rectangle is in screen coordinates, which aren't known until the baked text is drawn
+	if (flags & C2D_WithClip)
+		return NULL;
+
+	u32 color = 0xFF000000;
+	float wrapWidth = 0.0f;
+	C2Di_TextLayer layers[C2Di_MAX_TEXT_LAYERS];
+	size_t numLayers = 0;
+
+	va_list va;
+	va_start(va, scaleY);
+	if (flags & C2D_WithColor)
+		color = va_arg(va, u32);
+	if (flags & C2D_WordWrap)
+		wrapWidth = va_arg(va, double); // Passed as float, but varargs promotes to double.
+	C2Di_ReadTextLayers(layers, &numLayers, flags, color, &va);
+	va_end(va);
+
+	C2D_TextLayout layout = C2D_TextLayoutNew(text, flags, scaleX, scaleY, wrapWidth);
+	if (!layout)
+		return NULL;
+
+	C3D_Tex* sheets;
+	size_t numSheets = C2Di_TextSheets(text, &sheets);
+
+	size_t numGlyphs = text->words ? text->end - text->begin : 0;
+	u32* offsets = (u32*)calloc(numSheets+1, sizeof(u32));
+	C2Di_Vertex* quads = (C2Di_Vertex*)malloc(4*numGlyphs*sizeof(C2Di_Vertex));
+	if (!offsets || (numGlyphs && !quads))
+	{
+		free(quads);
+		free(offsets);
+		C2D_TextLayoutDelete(layout);
+		return NULL;
+	}
+
+	// Group the glyphs by sheet, in the same way as C2D_TextOptimize
+	const C2Di_Glyph* glyphs = &text->buf->glyphs[text->begin];
+	size_t i, numRuns = 0;
+	for (i = 0; i < numGlyphs; i ++)
+		if (offsets[glyphs[i].sheet + 1]++ == 0)
+			numRuns++;
+
+	size_t numQuads = numLayers*numGlyphs;
+	C2D_BakedText baked = (C2D_BakedText)malloc(sizeof(struct C2D_BakedText_s) + numRuns*sizeof(C2Di_BakedRun) + 4*numQuads*sizeof(C2Di_Vertex));
+	if (!baked)
+	{
+		free(quads);
+		free(offsets);
+		C2D_TextLayoutDelete(layout);
+		return NULL;
+	}
+	baked->font     = text->font;
+	baked->numRuns  = numRuns;
+	baked->numQuads = numQuads;
+	baked->vertices = (C2Di_Vertex*)&baked->runs[numRuns];
+
+	// Each run holds all the layers of its glyphs, from the first to the last (see C2Di_DrawTextLines)
+	size_t run = 0;
+	for (i = 0; i < numSheets; i ++)
+	{
+		u32 count = offsets[i+1];
+		offsets[i+1] += offsets[i];
+		if (!count)
+			continue;
+		baked->runs[run].sheet = &sheets[i];
+		baked->runs[run].start = 4*numLayers*offsets[i];
+		baked->runs[run].count = numLayers*count;
+		run++;
+	}
+
+	// Pre-transform the quads relative to the origin of the text, grouped by sheet
+	float glyphH = layout->glyphH;
+	for (i = 0; i < numGlyphs; i ++)
+	{
+		const C2Di_Glyph* cur = &glyphs[i];
+		C2Di_Vertex* vtx = &quads[4*offsets[cur->sheet]++];
+		float glyphW = layout->scaleX*cur->width;
+		float glyphX = layout->glyphPos[i].x;
+		float glyphY = layout->glyphPos[i].y;
+
+		C2Di_Texcoord temp;
+		C2Di_SetGlyphQuad(vtx, C2Di_GlyphTexcoord(text->font, C2Di_FontGetSheetTexcoords(text->font, cur->sheet), cur, &temp),
+			glyphX, glyphY, 0.0f, glyphW, glyphH, C2Di_GlyphColor(text->buf, cur, color));
+	}
+
+	// Then copy them to every layer of their run, the quads of the last layer are the text itself
+	const C2Di_Vertex* src = quads;
+	for (run = 0; run < numRuns; run ++)
+	{
+		u32 count = baked->runs[run].count/numLayers;
+		C2Di_Vertex* dst = &baked->vertices[baked->runs[run].start];
+		size_t layer;
+		for (layer = 0; layer < numLayers; layer ++, dst += 4*count)
 		{
-			if (!(flags & C2D_WordWrap))
-			{
-				lines = alloca(sizeof(*lines)*text->lines);
-				words = alloca(sizeof(*words)*text->words);
-				C2Di_CalcLineInfo(text, lines, words);
-			}
-			// Get total width available for whitespace for all lines after wrapping
-			struct
-			{
-				float whitespaceWidth;
-				u32 wordStart;
-				u32 words;
-			} justifiedLineInfo[words[text->words - 1].newLineNumber + 1];
-			for (u32 i = 0; i < words[text->words - 1].newLineNumber + 1; i++)
-			{
-				justifiedLineInfo[i].whitespaceWidth = 0;
-				justifiedLineInfo[i].words = 0;
-				justifiedLineInfo[i].wordStart = 0;
-			}
-			for (u32 i = 0; i < text->words; i++)
-			{
-				// Calculate the total text width
-				justifiedLineInfo[words[i].newLineNumber].whitespaceWidth += words[i].end->xPos + words[i].end->width - words[i].start->xPos;
-				// Increment amount of words
-				justifiedLineInfo[words[i].newLineNumber].words++;
-				// And set the word starts
-				if (i > 0 && words[i-1].newLineNumber != words[i].newLineNumber)
-					justifiedLineInfo[words[i].newLineNumber].wordStart = i;
-			}
-			for (u32 i = 0; i < words[text->words - 1].newLineNumber + 1; i++)
+			const C2Di_TextLayer* l = &layers[layer];
+			memcpy(dst, src, 4*count*sizeof(C2Di_Vertex));
+			if (l->markup)
+				continue;
+			u32 j;
+			for (j = 0; j < 4*count; j ++)
 			{
-				// Transform it from total text width to total whitespace width
-				justifiedLineInfo[i].whitespaceWidth = maxWidth - scaleX*justifiedLineInfo[i].whitespaceWidth;
-				// And then get the width of a single whitespace
-				if (justifiedLineInfo[i].words > 1)
-					justifiedLineInfo[i].whitespaceWidth /= justifiedLineInfo[i].words - 1;
+				dst[j].pos[0] += l->dx;
+				dst[j].pos[1] += l->dy;
+				dst[j].color   = l->color;
 			}
+		}
+		src += 4*count;
+	}
 
-			// Set up final word beginnings and ends
-			struct
-			{
-				float xBegin;
-				float xEnd;
-			} wordPositions[text->words];
-			wordPositions[0].xBegin = 0;
-			wordPositions[0].xEnd = wordPositions[0].xBegin + words[0].end->xPos + words[0].end->width - words[0].start->xPos;
-			for (u32 i = 1; i < text->words; i++)
-			{
-				wordPositions[i].xBegin = words[i-1].newLineNumber != words[i].newLineNumber ? 0 : wordPositions[i-1].xEnd;
-				wordPositions[i].xEnd = wordPositions[i].xBegin + words[i].end->xPos + words[i].end->width - words[i].start->xPos;
-			}
+	free(quads);
+	free(offsets);
+	C2D_TextLayoutDelete(layout);
+	return baked;
+}
 
-			for (cur = begin; cur != end; cur++)
-			{
-				u32 consecutiveWordNum = cur->wordNo + lines[cur->lineNo].wordStart;
-				float glyphW = scaleX*cur->width;
-				// The given X position, plus the scaled beginning position for this word, plus the offset of this glyph within the word, plus the whitespace width for this line times the word number within the line
-				float glyphX = x + scaleX*wordPositions[consecutiveWordNum].xBegin + scaleX*(cur->xPos - words[consecutiveWordNum].start->xPos) + justifiedLineInfo[words[consecutiveWordNum].newLineNumber].whitespaceWidth*(consecutiveWordNum - justifiedLineInfo[words[consecutiveWordNum].newLineNumber].wordStart);
-				float glyphY = y + dispY*words[consecutiveWordNum].newLineNumber;
-
-				C2Di_SetTex(cur->sheet);
-				C2Di_Update();
-				C2Di_AppendQuad();
-				C2Di_AppendVtx(glyphX,        glyphY,        glyphZ, cur->texcoord.left,  cur->texcoord.top,    0.0f, 1.0f, color);
-				C2Di_AppendVtx(glyphX+glyphW, glyphY,        glyphZ, cur->texcoord.right, cur->texcoord.top,    0.0f, 1.0f, color);
-				C2Di_AppendVtx(glyphX,        glyphY+glyphH, glyphZ, cur->texcoord.left,  cur->texcoord.bottom, 0.0f, 1.0f, color);
-				C2Di_AppendVtx(glyphX+glyphW, glyphY+glyphH, glyphZ, cur->texcoord.right, cur->texcoord.bottom, 0.0f, 1.0f, color);
-			}
+void C2D_BakedTextDelete(C2D_BakedText baked)
+{
+	free(baked);
+}
+
+bool C2D_DrawBakedText(C2D_BakedText baked, float x, float y, float z)
+{
+	C2Di_Context* ctx = C2Di_GetContext();
+	if (!(ctx->flags & C2DiF_Active))
+		return false;
+	if (!C2Di_CheckBufSpace(ctx, 6*baked->numQuads, 4*baked->numQuads))
+		return false;
+
+	// Sheets of streamed fonts may have been evicted since the text was baked
+	size_t i;
+	if (baked->font && baked->font->stream)
+		for (i = 0; i < baked->numRuns; i ++)
+			if (!C2Di_FontLoadSheet(baked->font, baked->runs[i].sheet - baked->font->glyphSheets))
+				return false;
+
+	C2Di_SetMode(C2Di_TextMode(baked->font));
+
+	for (i = 0; i < baked->numRuns; i ++)
+	{
+		const C2Di_BakedRun* run = &baked->runs[i];
+		C2Di_SetTex(run->sheet);
+		C2Di_Update();
+
+		// Replay the run, only applying the translation
+		const C2Di_Vertex* src = &baked->vertices[run->start];
+		C2Di_Vertex* dst = C2Di_AppendQuads(run->count);
+		memcpy(dst, src, 4*run->count*sizeof(C2Di_Vertex));
+
+		u32 j;
+		for (j = 0; j < 4*run->count; j ++)
+		{
+			dst[j].pos[0] += x;
+			dst[j].pos[1] += y;
+			dst[j].pos[2]  = z;
 		}
-		break;
 	}
+	return true;
 }
@@ -0,0 +1,55 @@
+// Starts loads from one thread while another keeps stopping the worker thread, then checks that every
+// load that was accepted gets done.
+#include <citro2d.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "host.h"
+
+#define NUM_JOBS 2000
+
+static C2D_LoadJob s_jobs[NUM_JOBS];
+static atomic_bool s_loading;
+
+static void* stopWorker(void* unused)
+{
+	(void)unused;
+	while (s_loading)
+	{
+		C2D_LoadJobsFini();
+		sched_yield();
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t thread;
+	s_loading = true;
+	pthread_create(&thread, NULL, stopWorker, NULL);
+
+	int i, accepted = 0;
+	for (i = 0; i < NUM_JOBS; i ++)
+	{
+		s_jobs[i] = C2D_FontLoadAsync("missing.bcfnt", NULL, NULL);
+		accepted += s_jobs[i] != NULL;
+		sched_yield();
+	}
+	s_loading = false;
+	pthread_join(thread, NULL);
+
+	// Stopping waits for every queued job
+	C2D_LoadJobsFini();
+	int failures = 0;
+	for (i = 0; i < NUM_JOBS; i ++)
+	{
+		if (s_jobs[i] && C2D_LoadJobPoll(s_jobs[i]) != C2D_LoadFailed)
+			failures++;
+		C2D_LoadJobFree(s_jobs[i]);
+	}
+
+	printf("%d of %d loads accepted, %d not done\n", accepted, NUM_JOBS, failures);
+	return failures || !accepted ? 1 : 0;
+}
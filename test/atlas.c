@@ -0,0 +1,142 @@
+// Draws text of a font loaded from memory through the glyph atlas, and checks that its glyphs are copied
+// into the atlas texel for texel and drawn from a single texture.
+#include <citro2d.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "host.h"
+#include "internal.h"
+
+#define NUM_CHARS   120
+#define ATLAS_SIZE  512
+
+static u32 s_codes[NUM_CHARS];
+
+static u8 atlasTexel(const C3D_Tex* tex, u32 x, u32 y)
+{
+	u32 index = hostTexelIndex(x, y, tex->width);
+	return (((const u8*)tex->data)[index>>1] >> ((index&1)*4)) & 0xF;
+}
+
+// Draws a text object, returns the number of texture switches
+static u32 drawText(const C2D_Text* text)
+{
+	C2Di_Context* ctx = C2Di_GetContext();
+	C2D_Prepare();
+	ctx->vtxBufPos = ctx->idxBufPos = ctx->idxBufLastPos = 0;
+
+	u32 binds = hostTexBinds;
+	C2D_DrawText(text, 0, 0.0f, 0.0f, 0.5f, 1.0f, 1.0f);
+	C2D_Flush();
+	return hostTexBinds - binds;
+}
+
+// Checks that each glyph is drawn from a copy of it in the atlas
+static int checkGlyphs(C2D_Font font)
+{
+	C2Di_Context* ctx = C2Di_GetContext();
+	const C3D_Tex* tex = ctx->curTex;
+	if (ctx->vtxBufPos != 4*NUM_CHARS)
+	{
+		printf("%zu vertices for %d glyphs\n", ctx->vtxBufPos, NUM_CHARS);
+		return 1;
+	}
+
+	int i, failures = 0;
+	for (i = 0; i < NUM_CHARS && failures < 10; i ++)
+	{
+		const C2Di_Vertex* vtx = &ctx->vtxBuf[4*i];
+		float left = vtx[0].texcoord[0], right = left, bottom = vtx[0].texcoord[1], top = bottom;
+		int j;
+		for (j = 1; j < 4; j ++)
+		{
+			left   = fminf(left, vtx[j].texcoord[0]);
+			right  = fmaxf(right, vtx[j].texcoord[0]);
+			bottom = fminf(bottom, vtx[j].texcoord[1]);
+			top    = fmaxf(top, vtx[j].texcoord[1]);
+		}
+
+		int glyphIndex = C2D_FontGlyphIndexFromCodePoint(font, s_codes[i]);
+		u32 glyphW = C2D_FontGetCharWidthInfo(font, glyphIndex)->glyphWidth;
+		u32 glyphH = C2D_FontGetInfo(font)->tglp->cellHeight;
+		u32 x0 = lroundf(left*tex->width), y0 = lroundf(bottom*tex->height);
+		if (lroundf(right*tex->width) - x0 != glyphW || lroundf(top*tex->height) - y0 != glyphH)
+		{
+			printf("Glyph %d: %ldx%ld in the atlas instead of %lux%lu\n", glyphIndex,
+				lroundf(right*tex->width) - (long)x0, lroundf(top*tex->height) - (long)y0, (unsigned long)glyphW, (unsigned long)glyphH);
+			failures++;
+			continue;
+		}
+
+		u32 x, y;
+		for (y = 0; y < glyphH; y ++)
+			for (x = 0; x < glyphW; x ++)
+				if (atlasTexel(tex, x0+x, y0+y) != hostFontTexel(glyphIndex, x, y))
+				{
+					printf("Glyph %d: texel %lu,%lu differs\n", glyphIndex, (unsigned long)x, (unsigned long)y);
+					failures++;
+					x = glyphW;
+					y = glyphH;
+				}
+	}
+	return failures;
+}
+
+int main(void)
+{
+	C2D_Init(4*NUM_CHARS);
+	C2D_Prepare();
+
+	// A single line of glyphs from many sheets
+	char str[NUM_CHARS*3+1];
+	char* p = str;
+	int i;
+	for (i = 0; i < NUM_CHARS; i ++)
+	{
+		s_codes[i] = (i & 1) ? 0x4E00 + (i*53) % 0x400 : '!' + i % 94;
+		p += encode_utf8((uint8_t*)p, s_codes[i]);
+	}
+	*p = 0;
+
+	size_t size;
+	void* data = hostFontCreate(&size);
+	C2D_Font font = C2D_FontLoadFromMem(data, size);
+	linearFree(data);
+	if (!font || !C2D_FontAtlasInit(font, ATLAS_SIZE, ATLAS_SIZE))
+	{
+		printf("Could not create the font or its atlas\n");
+		return 1;
+	}
+
+	C2D_TextBuf buf = C2D_TextBufNew(2*NUM_CHARS);
+	C2D_Text text, systemText;
+	C2D_TextFontParse(&text, font, buf, str);
+	C2D_TextParse(&systemText, buf, str);
+
+	int failures = 0;
+	u32 binds = drawText(&text);
+	if (binds != 1)
+	{
+		printf("%lu texture switches with the atlas\n", (unsigned long)binds);
+		failures++;
+	}
+	failures += checkGlyphs(font);
+
+	// Other fonts don't use the atlas
+	binds = drawText(&systemText);
+	if (binds <= 1)
+	{
+		printf("%lu texture switches for the system font\n", (unsigned long)binds);
+		failures++;
+	}
+
+	// The atlas keeps the font alive
+	C2D_FontFree(font);
+	drawText(&text);
+	failures += checkGlyphs(font);
+
+	C2D_FontAtlasFini();
+	C2D_TextBufDelete(buf);
+	C2D_Fini();
+	return failures ? 1 : 0;
+}
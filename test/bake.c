@@ -0,0 +1,135 @@
+// Checks that baked text is drawn like the text object it was baked from, including shadows and outlines,
+// that both are drawn with as many texture switches as without them, and that C2D_WithClip is rejected.
+#include <citro2d.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "internal.h"
+
+#define MAX_QUADS 4096
+
+static int compareVertex(const void* a, const void* b)
+{
+	return memcmp(a, b, sizeof(C2Di_Vertex));
+}
+
+// Layers are placed with different float operations when drawing and baking, positions are compared in 1/64 pixels
+static size_t takeVertices(C2Di_Vertex* vertices)
+{
+	C2Di_Context* ctx = C2Di_GetContext();
+	size_t i, n = ctx->vtxBufPos;
+	memcpy(vertices, ctx->vtxBuf, n*sizeof(C2Di_Vertex));
+	for (i = 0; i < n; i ++)
+	{
+		vertices[i].pos[0] = roundf(vertices[i].pos[0]*64.0f);
+		vertices[i].pos[1] = roundf(vertices[i].pos[1]*64.0f);
+	}
+	qsort(vertices, n, sizeof(C2Di_Vertex), compareVertex);
+	return n;
+}
+
+static void beginDraw(void)
+{
+	C2Di_Context* ctx = C2Di_GetContext();
+	C2D_Prepare();
+	ctx->vtxBufPos = ctx->idxBufPos = ctx->idxBufLastPos = 0;
+}
+
+int main(void)
+{
+	static C2Di_Vertex drawn[4*MAX_QUADS], baked[4*MAX_QUADS];
+	C2D_Init(MAX_QUADS);
+
+	// Glyphs from several sheets, some with a markup color
+	C2D_TextBuf buf = C2D_TextBufNew(256);
+	C2D_Text text;
+	C2D_TextFontParseEx(&text, NULL, buf, "Hello {#FF8000}\xE4\xB8\x80\xE4\xB8\x81{#} world\n\xE4\xBA\x8C\xE4\xB8\x83 again", C2D_ParseColorMarkup);
+
+	u32 color = C2D_Color32(0x20, 0x40, 0x60, 0xFF), shadow = C2D_Color32(0, 0, 0, 0x80), outline = C2D_Color32(0xFF, 0xFF, 0xFF, 0xFF);
+	int failures = 0;
+	u32 sheetBinds = 0, sheetDrawnBinds = 0; // Without layers, one per glyph sheet
+	int i;
+	for (i = 0; i < 4; i ++)
+	{
+		C2D_BakedText bakedText = NULL;
+		u32 binds = 0, drawnBinds;
+		const float x = 12.0f, y = 34.0f, z = 0.5f, scale = 0.75f;
+		beginDraw();
+		drawnBinds = hostTexBinds;
+		switch (i)
+		{
+			case 0:
+				C2D_DrawText(&text, C2D_WithColor, x, y, z, scale, scale, color);
+				bakedText = C2D_TextBake(&text, C2D_WithColor, scale, scale, color);
+				break;
+			case 1:
+				C2D_DrawText(&text, C2D_WithShadow, x, y, z, scale, scale, shadow, 2.0f, 3.0f);
+				bakedText = C2D_TextBake(&text, C2D_WithShadow, scale, scale, shadow, 2.0f, 3.0f);
+				break;
+			case 2:
+				C2D_DrawText(&text, C2D_WithColor|C2D_WithOutline, x, y, z, scale, scale, color, outline, 1.5f);
+				bakedText = C2D_TextBake(&text, C2D_WithColor|C2D_WithOutline, scale, scale, color, outline, 1.5f);
+				break;
+			case 3:
+			{
+				u32 flags = C2D_WithColor|C2D_AlignCenter|C2D_WordWrap|C2D_WithShadow|C2D_WithOutline;
+				C2D_DrawText(&text, flags, x, y, z, scale, scale, color, 80.0f, shadow, -1.0f, 2.0f, outline, 1.0f);
+				bakedText = C2D_TextBake(&text, flags, scale, scale, color, 80.0f, shadow, -1.0f, 2.0f, outline, 1.0f);
+				break;
+			}
+		}
+		C2D_Flush();
+		drawnBinds = hostTexBinds - drawnBinds;
+		size_t numDrawn = takeVertices(drawn);
+
+		if (i == 0)
+			sheetDrawnBinds = drawnBinds;
+		else if (drawnBinds != sheetDrawnBinds)
+		{
+			printf("case %d: the text is drawn with %lu texture switches instead of %lu\n", i, (unsigned long)drawnBinds, (unsigned long)sheetDrawnBinds);
+			failures++;
+		}
+
+		if (!bakedText)
+		{
+			printf("case %d: the text wasn't baked\n", i);
+			failures++;
+			continue;
+		}
+		beginDraw();
+		binds = hostTexBinds;
+		C2D_DrawBakedText(bakedText, x, y, z);
+		C2D_Flush();
+		binds = hostTexBinds - binds;
+		size_t numBaked = takeVertices(baked);
+		C2D_BakedTextDelete(bakedText);
+
+		if (numBaked != numDrawn || memcmp(baked, drawn, numDrawn*sizeof(C2Di_Vertex)) != 0)
+		{
+			printf("case %d: baked text isn't drawn like the text (%zu and %zu vertices)\n", i, numBaked, numDrawn);
+			failures++;
+		}
+		if (i == 0)
+			sheetBinds = binds;
+		else if (binds != sheetBinds)
+		{
+			printf("case %d: %lu texture switches instead of %lu\n", i, (unsigned long)binds, (unsigned long)sheetBinds);
+			failures++;
+		}
+	}
+
+	// The clip rectangle can't be baked
+	C2D_BakedText clipped = C2D_TextBake(&text, C2D_WithClip, 1.0f, 1.0f, 0.0f, 0.0f, 100.0f, 100.0f);
+	if (clipped)
+	{
+		printf("C2D_WithClip: the text was baked\n");
+		C2D_BakedTextDelete(clipped);
+		failures++;
+	}
+
+	C2D_TextBufDelete(buf);
+	C2D_Fini();
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+// Scaling of C2D_TextFontParseMany with the number of threads, against parsing the same strings one by one.
+// On the host, the worker threads are limited by the number of cores (see C2Di_ParseCores).
+#include <citro2d.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "host.h"
+
+#define NUM_STRS   4096
+#define STR_WORDS  24
+#define ROUNDS     9 // The best one is reported
+
+static const char* const s_words[] =
+{
+	"The", "quick", "brown", "fox", "jumps", "over", "the", "lazy", "dog,", "Caf\xC3\xA9", "na\xC3\xAFve",
+	"\xE4\xB8\x80\xE4\xB8\x81\xE4\xB8\x82", "d\xC3\xA9j\xC3\xA0", "\xE3\x80\x8C\xE4\xB8\x83\xE4\xB8\x87\xE3\x80\x8D",
+	"\xE2\x86\x92", "text\xE2\x80\xA6",
+};
+#define NUM_WORDS (sizeof(s_words)/sizeof(s_words[0]))
+
+static char* makeString(u32 seed)
+{
+	char* str = (char*)malloc(STR_WORDS*16 + 1);
+	char* p = str;
+	int i;
+	for (i = 0; i < STR_WORDS; i ++)
+	{
+		seed = seed*1103515245 + 12345;
+		const char* word = s_words[(seed >> 16) % NUM_WORDS];
+		size_t len = strlen(word);
+		memcpy(p, word, len);
+		p += len;
+		*p++ = i % 8 == 7 ? '\n' : ' ';
+	}
+	*p = 0;
+	return str;
+}
+
+// Best time of a few rounds, in seconds. maxThreads is 0 for parsing the strings one by one.
+static double bench(C2D_Text* texts, const char* const* strs, size_t totalLen, u32 maxThreads)
+{
+	double best = 0.0;
+	int round;
+	for (round = 0; round < ROUNDS; round ++)
+	{
+		double start = hostTime();
+		C2D_TextBuf buf;
+		if (maxThreads)
+			buf = C2D_TextFontParseMany(texts, NULL, strs, NUM_STRS, 0, maxThreads);
+		else
+		{
+			buf = C2D_TextBufNew(totalLen);
+			size_t i;
+			for (i = 0; i < NUM_STRS; i ++)
+				C2D_TextFontParseEx(&texts[i], NULL, buf, strs[i], 0);
+		}
+		double elapsed = hostTime() - start;
+		if (!buf)
+		{
+			printf("out of memory\n");
+			exit(1);
+		}
+		C2D_TextBufDelete(buf);
+		if (round == 0 || elapsed < best)
+			best = elapsed;
+	}
+	return best;
+}
+
+int main(void)
+{
+	static char* strs[NUM_STRS];
+	static C2D_Text texts[NUM_STRS];
+	size_t totalLen = 0, i;
+	for (i = 0; i < NUM_STRS; i ++)
+	{
+		strs[i] = makeString(i);
+		totalLen += strlen(strs[i]);
+	}
+
+	// Warm up the glyph cache of the font
+	bench(texts, (const char* const*)strs, totalLen, 0);
+
+	printf("%d strings, %zu bytes, %ld cores\n", NUM_STRS, totalLen, sysconf(_SC_NPROCESSORS_ONLN));
+	double serial = bench(texts, (const char* const*)strs, totalLen, 0);
+	printf("serial     %8.2f ms\n", serial*1e3);
+	u32 threads;
+	for (threads = 1; threads <= 8; threads *= 2)
+	{
+		double t = bench(texts, (const char* const*)strs, totalLen, threads);
+		printf("%u thread%s  %8.2f ms  %5.2fx\n", threads, threads == 1 ? " " : "s", t*1e3, serial/t);
+	}
+
+	for (i = 0; i < NUM_STRS; i ++)
+		free(strs[i]);
+	return 0;
+}
@@ -0,0 +1,85 @@
+// Parse throughput of the system font, for ASCII and for mixed UTF-8 text. Only uses the public API,
+// so the same file can be built against older versions of the library for comparison.
+#include <citro2d.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+
+#define LINES      64
+#define ITERATIONS 1000
+#define ROUNDS     9 // The best one is reported
+
+static char* makeText(const char* const* words, size_t numWords)
+{
+	size_t cap = 1, i, line;
+	for (i = 0; i < numWords; i ++)
+		cap += strlen(words[i]) + 1;
+	cap *= LINES;
+
+	char* str = (char*)malloc(cap);
+	char* p = str;
+	for (line = 0; line < LINES; line ++)
+	{
+		for (i = 0; i < numWords; i ++)
+		{
+			size_t len = strlen(words[i]);
+			memcpy(p, words[i], len);
+			p += len;
+			*p++ = i + 1 < numWords ? ' ' : '\n';
+		}
+	}
+	*p = 0;
+	return str;
+}
+
+static void bench(const char* name, const char* str)
+{
+	size_t len = strlen(str);
+	C2D_TextBuf buf = C2D_TextBufNew(len);
+	C2D_Text text;
+	int i, round;
+
+	// Warm up the glyph caches
+	C2D_TextParse(&text, buf, str);
+
+	double best = 0.0;
+	for (round = 0; round < ROUNDS; round ++)
+	{
+		double start = hostTime();
+		for (i = 0; i < ITERATIONS; i ++)
+		{
+			C2D_TextBufClear(buf);
+			C2D_TextParse(&text, buf, str);
+		}
+		double elapsed = hostTime() - start;
+		if (round == 0 || elapsed < best)
+			best = elapsed;
+	}
+
+	printf("%-8s %7zu bytes %6zu glyphs %8.1f MB/s\n", name, len, text.end - text.begin, len*(double)ITERATIONS/best/1e6);
+	C2D_TextBufDelete(buf);
+}
+
+int main(void)
+{
+	static const char* const ascii[] =
+	{
+		"The", "quick", "brown", "fox", "jumps", "over", "the", "lazy", "dog,", "then", "it",
+		"sleeps", "for", "a", "while", "before", "doing", "it", "all", "over", "again.",
+	};
+	static const char* const mixed[] =
+	{
+		"Caf\xC3\xA9", "na\xC3\xAFve", "\xE4\xB8\x80\xE4\xB8\x81\xE4\xB8\x82", "d\xC3\xA9j\xC3\xA0", "vu",
+		"\xE3\x80\x8C\xE4\xB8\x83\xE4\xB8\x87\xE3\x80\x8D", "and", "more", "\xE2\x86\x92", "text\xE2\x80\xA6",
+	};
+
+	char* str = makeText(ascii, sizeof(ascii)/sizeof(ascii[0]));
+	bench("ascii", str);
+	free(str);
+
+	str = makeText(mixed, sizeof(mixed)/sizeof(mixed[0]));
+	bench("mixed", str);
+	free(str);
+	return 0;
+}
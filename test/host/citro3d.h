@@ -0,0 +1,322 @@
+// Host stand-in for the parts of libctru and citro3d that citro2d uses, so that the library can be built and tested
+// on a PC. GPU calls do nothing, memory and font functions behave like their 3DS counterparts (see host.c).
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/types.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef s32 Result;
+typedef u32 Handle;
+
+#define BIT(n) (1U<<(n))
+#define U64_MAX UINT64_MAX
+#define R_FAILED(res)    ((Result)(res) < 0)
+#define R_SUCCEEDED(res) ((Result)(res) >= 0)
+
+// System
+#define USERBREAK_PANIC   0
+#define CUR_THREAD_HANDLE 0xFFFF8000
+enum { MEDIATYPE_NAND };
+
+void svcBreak(int reason);
+Result svcGetThreadPriority(s32* out, Handle handle);
+Result svcSetThreadPriority(Handle handle, s32 priority);
+
+void* linearAlloc(size_t size);
+void* linearMemAlign(size_t size, size_t alignment);
+void linearFree(void* mem);
+u32 linearSpaceFree(void);
+
+typedef struct Thread_tag* Thread;
+typedef void (*ThreadFunc)(void*);
+Thread threadCreate(ThreadFunc entrypoint, void* arg, size_t stackSize, int prio, int coreId, bool detached);
+Result threadJoin(Thread thread, u64 timeoutNs);
+void threadFree(Thread thread);
+
+Result APT_CheckNew3DS(bool* out);
+Result APT_GetAppCpuTimeLimit(u32* percent);
+Result APT_SetAppCpuTimeLimit(u32 percent);
+
+ssize_t decode_utf8(uint32_t* out, const uint8_t* in);
+ssize_t encode_utf8(uint8_t* out, uint32_t in);
+
+typedef ssize_t (*decompressCallback)(void* userdata, void* buffer, size_t size);
+bool decompress_LZ11(void* output, size_t size, decompressCallback callback, void* userdata, size_t insize);
+
+Result romfsMountFromTitle(u64 tid, int mediatype, const char* name);
+Result romfsUnmount(const char* name);
+
+typedef enum
+{
+	CFG_REGION_JPN,
+	CFG_REGION_USA,
+	CFG_REGION_EUR,
+	CFG_REGION_AUS,
+	CFG_REGION_CHN,
+	CFG_REGION_KOR,
+	CFG_REGION_TWN,
+} CFG_Region;
+
+Result CFGU_SecureInfoGetRegion(u8* region);
+
+// Graphics
+#define GSP_SCREEN_WIDTH          240
+#define GSP_SCREEN_HEIGHT_TOP     400
+#define GSP_SCREEN_HEIGHT_TOP_2X  800
+#define GSP_SCREEN_HEIGHT_BOTTOM  320
+
+typedef enum { GFX_TOP, GFX_BOTTOM } gfxScreen_t;
+typedef enum { GFX_LEFT, GFX_RIGHT } gfx3dSide_t;
+bool gfxIsWide(void);
+
+#define GX_TRANSFER_FLIP_VERT(x)  (x)
+#define GX_TRANSFER_OUT_TILED(x)  (x)
+#define GX_TRANSFER_RAW_COPY(x)   (x)
+#define GX_TRANSFER_IN_FORMAT(x)  (x)
+#define GX_TRANSFER_OUT_FORMAT(x) (x)
+#define GX_TRANSFER_SCALING(x)    (x)
+enum { GX_TRANSFER_FMT_RGBA8, GX_TRANSFER_FMT_RGB8, GX_TRANSFER_SCALE_NO };
+
+typedef enum
+{
+	GPU_RGBA8, GPU_RGB8, GPU_RGBA5551, GPU_RGB565, GPU_RGBA4, GPU_LA8, GPU_HILO8,
+	GPU_L8, GPU_A8, GPU_LA4, GPU_L4, GPU_A4, GPU_ETC1, GPU_ETC1A4,
+} GPU_TEXCOLOR;
+
+typedef enum { GPU_NEAREST, GPU_LINEAR } GPU_TEXTURE_FILTER_PARAM;
+enum { GPU_CLAMP_TO_EDGE, GPU_CLAMP_TO_BORDER, GPU_REPEAT, GPU_MIRRORED_REPEAT };
+
+#define GPU_TEXTURE_MAG_FILTER(v) ((v)<<1)
+#define GPU_TEXTURE_MIN_FILTER(v) ((v)<<2)
+#define GPU_TEXTURE_WRAP_S(v)     ((v)<<12)
+#define GPU_TEXTURE_WRAP_T(v)     ((v)<<8)
+
+typedef int GPU_TEVSRC;
+enum
+{
+	GPU_PRIMARY_COLOR, GPU_TEXTURE0, GPU_TEXTURE3, GPU_CONSTANT, GPU_PREVIOUS,
+	GPU_REPLACE, GPU_MODULATE, GPU_ADD, GPU_INTERPOLATE, GPU_SUBTRACT, GPU_DOT3_RGB, GPU_MULTIPLY_ADD,
+	GPU_TEVOP_RGB_SRC_COLOR, GPU_TEVOP_RGB_ONE_MINUS_SRC_COLOR, GPU_TEVOP_RGB_SRC_ALPHA, GPU_TEVOP_RGB_ONE_MINUS_SRC_ALPHA,
+	GPU_TEVOP_A_SRC_ALPHA, GPU_TEVOP_A_SRC_R,
+	GPU_TEVSCALE_1, GPU_TEVSCALE_2, GPU_TEVSCALE_4,
+	GPU_NEVER, GPU_ALWAYS, GPU_GEQUAL, GPU_GREATER,
+	GPU_WRITE_ALL, GPU_CULL_NONE, GPU_TRIANGLES, GPU_VERTEX_SHADER,
+	GPU_FLOAT, GPU_UNSIGNED_BYTE, GPU_RB_RGBA8, GPU_RB_DEPTH16,
+	GPU_PT_CLAMP_TO_EDGE, GPU_PT_MIRRORED_REPEAT, GPU_PT_U, GPU_PT_V, GPU_PT_SQRT2, GPU_PT_LINEAR, GPU_LUT_ALPHAMAP,
+};
+
+enum { C3D_UNSIGNED_SHORT = 1 };
+enum { C3D_RGB = 1, C3D_Alpha = 2, C3D_Both = 3 };
+enum { C3D_CLEAR_ALL = 7 };
+enum { C3D_FRAME_SYNCDRAW = 1 };
+
+#define C3D_AngleFromDegrees(angle) ((angle)*(float)M_PI/180.0f)
+
+typedef struct
+{
+	void* data;
+	GPU_TEXCOLOR fmt;
+	size_t size;
+	u16 width, height;
+	u32 param;
+	u32 border;
+	u32 lodParam;
+} C3D_Tex;
+
+typedef union
+{
+	struct { float w, z, y, x; };
+	float c[4];
+} C3D_FVec;
+
+typedef union
+{
+	C3D_FVec r[4];
+	float m[16];
+} C3D_Mtx;
+
+typedef struct { int unused; } C3D_AttrInfo;
+typedef struct { int unused; } C3D_BufInfo;
+typedef struct { int unused; } C3D_TexEnv;
+typedef struct { int unused; } C3D_ProcTex;
+typedef struct { int unused; } C3D_ProcTexLut;
+typedef struct { struct { u16 width, height; } frameBuf; bool linked; } C3D_RenderTarget;
+
+typedef struct { int unused; } DVLE_s;
+typedef struct { u32 numDVLE; DVLE_s* DVLE; } DVLB_s;
+typedef struct { void* vertexShader; } shaderProgram_s;
+
+void C3D_FrameEndHook(void (*hook)(void*), void* param);
+void C3D_FrameSplit(u8 flags);
+bool C3D_FrameDrawOn(C3D_RenderTarget* target);
+void C3D_BindProgram(shaderProgram_s* program);
+void C3D_SetAttrInfo(C3D_AttrInfo* info);
+void C3D_SetBufInfo(C3D_BufInfo* info);
+C3D_BufInfo* C3D_GetBufInfo(void);
+void C3D_DrawElements(int primitive, int count, int type, const void* indices);
+void C3D_FVUnifMtx4x4(int type, int id, const C3D_Mtx* mtx);
+void C3D_DepthTest(bool enable, int function, int writemask);
+void C3D_AlphaTest(bool enable, int function, int ref);
+void C3D_CullFace(int mode);
+
+C3D_TexEnv* C3D_GetTexEnv(int id);
+void C3D_TexEnvInit(C3D_TexEnv* env);
+void C3D_TexEnvSrc(C3D_TexEnv* env, int mode, int s1, int s2, int s3);
+void C3D_TexEnvOpRgb(C3D_TexEnv* env, int o1, int o2, int o3);
+void C3D_TexEnvOpAlpha(C3D_TexEnv* env, int o1, int o2, int o3);
+void C3D_TexEnvFunc(C3D_TexEnv* env, int mode, int param);
+void C3D_TexEnvColor(C3D_TexEnv* env, u32 color);
+void C3D_TexEnvScale(C3D_TexEnv* env, int mode, int param);
+
+bool C3D_TexInit(C3D_Tex* tex, u16 width, u16 height, GPU_TEXCOLOR format);
+void C3D_TexDelete(C3D_Tex* tex);
+void C3D_TexFlush(C3D_Tex* tex);
+void C3D_TexBind(int unitId, C3D_Tex* tex);
+void C3D_TexSetFilter(C3D_Tex* tex, GPU_TEXTURE_FILTER_PARAM magFilter, GPU_TEXTURE_FILTER_PARAM minFilter);
+void C3D_TexSetWrap(C3D_Tex* tex, int wrapS, int wrapT);
+
+void C3D_ProcTexInit(C3D_ProcTex* pt, int offset, int length);
+void C3D_ProcTexClamp(C3D_ProcTex* pt, int u, int v);
+void C3D_ProcTexCombiner(C3D_ProcTex* pt, bool alpha, int u, int v);
+void C3D_ProcTexFilter(C3D_ProcTex* pt, int min);
+void C3D_ProcTexBind(int texCoordId, C3D_ProcTex* pt);
+void C3D_ProcTexLutBind(int id, C3D_ProcTexLut* lut);
+void ProcTexLut_FromArray(C3D_ProcTexLut* lut, const float in[129]);
+
+C3D_RenderTarget* C3D_RenderTargetCreate(int width, int height, int colorFmt, int depthFmt);
+void C3D_RenderTargetClear(C3D_RenderTarget* target, int bits, u32 clearColor, u32 clearDepth);
+void C3D_RenderTargetSetOutput(C3D_RenderTarget* target, gfxScreen_t screen, gfx3dSide_t side, u32 transferFlags);
+
+DVLB_s* DVLB_ParseFile(u32* shbinData, u32 shbinSize);
+void DVLB_Free(DVLB_s* dvlb);
+void shaderProgramInit(shaderProgram_s* sp);
+void shaderProgramSetVsh(shaderProgram_s* sp, DVLE_s* dvle);
+void shaderProgramFree(shaderProgram_s* sp);
+int shaderInstanceGetUniformLocation(void* si, const char* name);
+
+void AttrInfo_Init(C3D_AttrInfo* info);
+int AttrInfo_AddLoader(C3D_AttrInfo* info, int regId, int format, int count);
+void BufInfo_Init(C3D_BufInfo* info);
+int BufInfo_Add(C3D_BufInfo* info, const void* data, ptrdiff_t stride, int attribCount, u64 permutation);
+
+void Mtx_Identity(C3D_Mtx* out);
+void Mtx_Copy(C3D_Mtx* out, const C3D_Mtx* in);
+void Mtx_Multiply(C3D_Mtx* out, const C3D_Mtx* a, const C3D_Mtx* b);
+void Mtx_Translate(C3D_Mtx* mtx, float x, float y, float z, bool bRightSide);
+void Mtx_Scale(C3D_Mtx* mtx, float x, float y, float z);
+void Mtx_RotateZ(C3D_Mtx* mtx, float angle, bool bRightSide);
+void Mtx_Ortho(C3D_Mtx* mtx, float left, float right, float bottom, float top, float near, float far, bool isLeftHanded);
+void Mtx_OrthoTilt(C3D_Mtx* mtx, float left, float right, float bottom, float top, float near, float far, bool isLeftHanded);
+
+// Fonts, with the same layout as libctru's except that pointers are native
+typedef struct
+{
+	s8 left;
+	u8 glyphWidth;
+	u8 charWidth;
+} charWidthInfo_s;
+
+typedef struct
+{
+	u8 cellWidth, cellHeight, baselinePos, maxCharWidth;
+	u32 sheetSize;
+	u16 nSheets, sheetFmt, nRows, nLines, sheetWidth, sheetHeight;
+	u8* sheetData;
+} TGLP_s;
+
+typedef struct tag_CWDH_s CWDH_s;
+struct tag_CWDH_s
+{
+	u16 startIndex, endIndex;
+	CWDH_s* next;
+	charWidthInfo_s widths[0];
+};
+
+enum
+{
+	CMAP_TYPE_DIRECT = 0,
+	CMAP_TYPE_TABLE  = 1,
+	CMAP_TYPE_SCAN   = 2,
+};
+
+typedef struct tag_CMAP_s CMAP_s;
+struct tag_CMAP_s
+{
+	u16 codeBegin, codeEnd;
+	u16 mappingMethod, reserved;
+	CMAP_s* next;
+	union
+	{
+		u16 indexOffset;
+		u16 indexTable[0];
+		struct
+		{
+			u16 nScanEntries;
+			struct { u16 code, glyphIndex; } scanEntries[0];
+		};
+	};
+};
+
+typedef struct
+{
+	u32 signature, sectionSize;
+	u8 fontType, lineFeed;
+	u16 alterCharIndex;
+	charWidthInfo_s defaultWidth;
+	u8 encoding;
+	TGLP_s* tglp;
+	CWDH_s* cwdh;
+	CMAP_s* cmap;
+	u8 height, width, ascent, padding;
+} FINF_s;
+
+typedef struct
+{
+	u32 signature;
+	u16 endianness, headerSize;
+	u32 version, fileSize, nBlocks;
+	FINF_s finf;
+} CFNT_s;
+
+typedef struct
+{
+	int sheetIndex;
+	float xOffset, xAdvance, width;
+	struct { float left, top, right, bottom; } texcoord;
+	struct { float left, top, right, bottom; } vtxcoord;
+} fontGlyphPos_s;
+
+Result fontEnsureMapped(void);
+CFNT_s* fontGetSystemFont(void);
+void fontFixPointers(CFNT_s* font);
+int fontGlyphIndexFromCodePoint(CFNT_s* font, u32 codePoint);
+charWidthInfo_s* fontGetCharWidthInfo(CFNT_s* font, int glyphIndex);
+void fontCalcGlyphPos(fontGlyphPos_s* out, CFNT_s* font, int glyphIndex, u32 flags, float scaleX, float scaleY);
+
+static inline FINF_s* fontGetInfo(CFNT_s* font)
+{
+	return &(font ? font : fontGetSystemFont())->finf;
+}
+
+static inline TGLP_s* fontGetGlyphInfo(CFNT_s* font)
+{
+	return fontGetInfo(font)->tglp;
+}
+
+static inline void* fontGetGlyphSheetTex(CFNT_s* font, int sheetIndex)
+{
+	TGLP_s* tglp = fontGetGlyphInfo(font);
+	return &tglp->sheetData[sheetIndex*tglp->sheetSize];
+}
@@ -0,0 +1,708 @@
+// libctru and citro3d stand-ins for the host tests. Font functions and decoders follow their libctru
+// counterparts, GPU functions only keep count of what would be drawn.
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <tex3ds.h>
+#include "host.h"
+#include "render2d_shbin.h"
+
+const unsigned char render2d_shbin[4];
+const unsigned int render2d_shbin_size = sizeof(render2d_shbin);
+
+u32 hostDrawCalls;
+u32 hostTexBinds;
+
+double hostTime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// System
+
+void svcBreak(int reason)
+{
+	(void)reason;
+	abort();
+}
+
+Result svcGetThreadPriority(s32* out, Handle handle)
+{
+	(void)handle;
+	*out = 0x30;
+	return 0;
+}
+
+Result svcSetThreadPriority(Handle handle, s32 priority)
+{
+	(void)handle;
+	(void)priority;
+	return 0;
+}
+
+void* linearMemAlign(size_t size, size_t alignment)
+{
+	void* mem;
+	return posix_memalign(&mem, alignment, size ? size : 1) == 0 ? mem : NULL;
+}
+
+void* linearAlloc(size_t size)
+{
+	return linearMemAlign(size, 0x80);
+}
+
+void linearFree(void* mem)
+{
+	free(mem);
+}
+
+u32 linearSpaceFree(void)
+{
+	return 64 << 20;
+}
+
+struct Thread_tag
+{
+	pthread_t thread;
+	ThreadFunc entrypoint;
+	void* arg;
+};
+
+static void* hostThreadEntry(void* arg)
+{
+	Thread thread = (Thread)arg;
+	thread->entrypoint(thread->arg);
+	return NULL;
+}
+
+Thread threadCreate(ThreadFunc entrypoint, void* arg, size_t stackSize, int prio, int coreId, bool detached)
+{
+	(void)stackSize;
+	(void)prio;
+	(void)coreId;
+	Thread thread = (Thread)malloc(sizeof(struct Thread_tag));
+	if (!thread || detached)
+	{
+		free(thread);
+		return NULL;
+	}
+	thread->entrypoint = entrypoint;
+	thread->arg = arg;
+	if (pthread_create(&thread->thread, NULL, hostThreadEntry, thread) != 0)
+	{
+		free(thread);
+		return NULL;
+	}
+	return thread;
+}
+
+Result threadJoin(Thread thread, u64 timeoutNs)
+{
+	(void)timeoutNs;
+	return pthread_join(thread->thread, NULL) == 0 ? 0 : -1;
+}
+
+void threadFree(Thread thread)
+{
+	free(thread);
+}
+
+Result APT_CheckNew3DS(bool* out)
+{
+	*out = false;
+	return 0;
+}
+
+Result APT_GetAppCpuTimeLimit(u32* percent)
+{
+	*percent = 0;
+	return 0;
+}
+
+Result APT_SetAppCpuTimeLimit(u32 percent)
+{
+	(void)percent;
+	return 0;
+}
+
+ssize_t decode_utf8(uint32_t* out, const uint8_t* in)
+{
+	uint8_t code1 = in[0], code2, code3, code4;
+	if (code1 < 0x80)
+	{
+		*out = code1;
+		return 1;
+	}
+	if (code1 < 0xC2)
+		return -1;
+	code2 = in[1];
+	if ((code2 & 0xC0) != 0x80)
+		return -1;
+	if (code1 < 0xE0)
+	{
+		*out = (code1 << 6) + code2 - 0x3080;
+		return 2;
+	}
+	if (code1 < 0xF0)
+	{
+		if (code1 == 0xE0 && code2 < 0xA0)
+			return -1;
+		code3 = in[2];
+		if ((code3 & 0xC0) != 0x80)
+			return -1;
+		*out = (code1 << 12) + (code2 << 6) + code3 - 0xE2080;
+		return 3;
+	}
+	if (code1 < 0xF5)
+	{
+		if ((code1 == 0xF0 && code2 < 0x90) || (code1 == 0xF4 && code2 >= 0x90))
+			return -1;
+		code3 = in[2];
+		if ((code3 & 0xC0) != 0x80)
+			return -1;
+		code4 = in[3];
+		if ((code4 & 0xC0) != 0x80)
+			return -1;
+		*out = ((u32)code1 << 18) + (code2 << 12) + (code3 << 6) + code4 - 0x3C82080;
+		return 4;
+	}
+	return -1;
+}
+
+ssize_t encode_utf8(uint8_t* out, uint32_t in)
+{
+	if (in < 0x80)
+	{
+		if (out)
+			out[0] = in;
+		return 1;
+	}
+	if (in < 0x800)
+	{
+		if (out)
+		{
+			out[0] = (in >> 6) + 0xC0;
+			out[1] = (in & 0x3F) + 0x80;
+		}
+		return 2;
+	}
+	if (in < 0x10000)
+	{
+		if (in >= 0xD800 && in < 0xE000)
+			return -1;
+		if (out)
+		{
+			out[0] = (in >> 12) + 0xE0;
+			out[1] = ((in >> 6) & 0x3F) + 0x80;
+			out[2] = (in & 0x3F) + 0x80;
+		}
+		return 3;
+	}
+	if (in < 0x110000)
+	{
+		if (out)
+		{
+			out[0] = (in >> 18) + 0xF0;
+			out[1] = ((in >> 12) & 0x3F) + 0x80;
+			out[2] = ((in >> 6) & 0x3F) + 0x80;
+			out[3] = (in & 0x3F) + 0x80;
+		}
+		return 4;
+	}
+	return -1;
+}
+
+// Same algorithm as libctru's, for input in memory (userdata points to it, there is no callback)
+bool decompress_LZ11(void* output, size_t size, decompressCallback callback, void* userdata, size_t insize)
+{
+	if (callback)
+		return false;
+
+	const u8* in = (const u8*)userdata;
+	const u8* inEnd = in + insize;
+	u8* out = (u8*)output;
+	u8* outStart = out;
+	while (size > 0)
+	{
+		if (in == inEnd)
+			return false;
+		u8 flags = *in++;
+		int i;
+		for (i = 0; i < 8 && size > 0; i ++, flags <<= 1)
+		{
+			if (!(flags & 0x80))
+			{
+				if (in == inEnd)
+					return false;
+				*out++ = *in++;
+				size--;
+				continue;
+			}
+
+			if (inEnd - in < 2)
+				return false;
+			u8 b0 = *in++, b1 = *in++;
+			size_t len, disp;
+			switch (b0 >> 4)
+			{
+				case 0:
+					if (in == inEnd)
+						return false;
+					len  = ((b0 << 4) | (b1 >> 4)) + 0x11;
+					disp = (((b1 & 0xF) << 8) | *in++) + 1;
+					break;
+				case 1:
+				{
+					if (inEnd - in < 2)
+						return false;
+					u8 b2 = *in++, b3 = *in++;
+					len  = (((b0 & 0xF) << 12) | (b1 << 4) | (b2 >> 4)) + 0x111;
+					disp = (((b2 & 0xF) << 8) | b3) + 1;
+					break;
+				}
+				default:
+					len  = (b0 >> 4) + 1;
+					disp = (((b0 & 0xF) << 8) | b1) + 1;
+					break;
+			}
+			if (disp > (size_t)(out - outStart))
+				return false;
+			if (len > size)
+				len = size;
+			size -= len;
+			while (len--)
+			{
+				*out = out[-disp];
+				out++;
+			}
+		}
+	}
+	return true;
+}
+
+Result romfsMountFromTitle(u64 tid, int mediatype, const char* name)
+{
+	(void)tid;
+	(void)mediatype;
+	(void)name;
+	return -1;
+}
+
+Result romfsUnmount(const char* name)
+{
+	(void)name;
+	return 0;
+}
+
+Result CFGU_SecureInfoGetRegion(u8* region)
+{
+	*region = CFG_REGION_USA;
+	return 0;
+}
+
+// Graphics
+
+bool gfxIsWide(void) { return false; }
+
+void C3D_FrameEndHook(void (*hook)(void*), void* param) { (void)hook; (void)param; }
+void C3D_FrameSplit(u8 flags) { (void)flags; }
+bool C3D_FrameDrawOn(C3D_RenderTarget* target) { (void)target; return true; }
+void C3D_BindProgram(shaderProgram_s* program) { (void)program; }
+void C3D_SetAttrInfo(C3D_AttrInfo* info) { (void)info; }
+void C3D_SetBufInfo(C3D_BufInfo* info) { (void)info; }
+void C3D_FVUnifMtx4x4(int type, int id, const C3D_Mtx* mtx) { (void)type; (void)id; (void)mtx; }
+void C3D_DepthTest(bool enable, int function, int writemask) { (void)enable; (void)function; (void)writemask; }
+void C3D_AlphaTest(bool enable, int function, int ref) { (void)enable; (void)function; (void)ref; }
+void C3D_CullFace(int mode) { (void)mode; }
+
+C3D_BufInfo* C3D_GetBufInfo(void)
+{
+	static C3D_BufInfo s_bufInfo;
+	return &s_bufInfo;
+}
+
+void C3D_DrawElements(int primitive, int count, int type, const void* indices)
+{
+	(void)primitive;
+	(void)count;
+	(void)type;
+	(void)indices;
+	hostDrawCalls++;
+}
+
+C3D_TexEnv* C3D_GetTexEnv(int id)
+{
+	static C3D_TexEnv s_texEnv[6];
+	return &s_texEnv[id];
+}
+
+void C3D_TexEnvInit(C3D_TexEnv* env) { (void)env; }
+void C3D_TexEnvSrc(C3D_TexEnv* env, int mode, int s1, int s2, int s3) { (void)env; (void)mode; (void)s1; (void)s2; (void)s3; }
+void C3D_TexEnvOpRgb(C3D_TexEnv* env, int o1, int o2, int o3) { (void)env; (void)o1; (void)o2; (void)o3; }
+void C3D_TexEnvOpAlpha(C3D_TexEnv* env, int o1, int o2, int o3) { (void)env; (void)o1; (void)o2; (void)o3; }
+void C3D_TexEnvFunc(C3D_TexEnv* env, int mode, int param) { (void)env; (void)mode; (void)param; }
+void C3D_TexEnvColor(C3D_TexEnv* env, u32 color) { (void)env; (void)color; }
+void C3D_TexEnvScale(C3D_TexEnv* env, int mode, int param) { (void)env; (void)mode; (void)param; }
+
+static u32 hostFormatBits(GPU_TEXCOLOR fmt)
+{
+	static const u8 s_bits[] = { 32, 24, 16, 16, 16, 16, 16, 8, 8, 8, 4, 4, 4, 8 };
+	return s_bits[fmt];
+}
+
+bool C3D_TexInit(C3D_Tex* tex, u16 width, u16 height, GPU_TEXCOLOR format)
+{
+	tex->size   = (size_t)width*height*hostFormatBits(format)/8;
+	tex->data   = linearAlloc(tex->size);
+	tex->fmt    = format;
+	tex->width  = width;
+	tex->height = height;
+	tex->param  = 0;
+	tex->border = 0;
+	tex->lodParam = 0;
+	if (tex->data)
+		memset(tex->data, 0, tex->size);
+	return tex->data != NULL;
+}
+
+void C3D_TexDelete(C3D_Tex* tex)
+{
+	linearFree(tex->data);
+	tex->data = NULL;
+}
+
+void C3D_TexBind(int unitId, C3D_Tex* tex)
+{
+	(void)unitId;
+	(void)tex;
+	hostTexBinds++;
+}
+
+void C3D_TexFlush(C3D_Tex* tex) { (void)tex; }
+void C3D_TexSetFilter(C3D_Tex* tex, GPU_TEXTURE_FILTER_PARAM magFilter, GPU_TEXTURE_FILTER_PARAM minFilter) { (void)tex; (void)magFilter; (void)minFilter; }
+void C3D_TexSetWrap(C3D_Tex* tex, int wrapS, int wrapT) { (void)tex; (void)wrapS; (void)wrapT; }
+
+void C3D_ProcTexInit(C3D_ProcTex* pt, int offset, int length) { (void)pt; (void)offset; (void)length; }
+void C3D_ProcTexClamp(C3D_ProcTex* pt, int u, int v) { (void)pt; (void)u; (void)v; }
+void C3D_ProcTexCombiner(C3D_ProcTex* pt, bool alpha, int u, int v) { (void)pt; (void)alpha; (void)u; (void)v; }
+void C3D_ProcTexFilter(C3D_ProcTex* pt, int min) { (void)pt; (void)min; }
+void C3D_ProcTexBind(int texCoordId, C3D_ProcTex* pt) { (void)texCoordId; (void)pt; }
+void C3D_ProcTexLutBind(int id, C3D_ProcTexLut* lut) { (void)id; (void)lut; }
+void ProcTexLut_FromArray(C3D_ProcTexLut* lut, const float in[129]) { (void)lut; (void)in; }
+
+C3D_RenderTarget* C3D_RenderTargetCreate(int width, int height, int colorFmt, int depthFmt)
+{
+	(void)colorFmt;
+	(void)depthFmt;
+	C3D_RenderTarget* target = (C3D_RenderTarget*)calloc(1, sizeof(C3D_RenderTarget));
+	if (target)
+	{
+		target->frameBuf.width  = width;
+		target->frameBuf.height = height;
+	}
+	return target;
+}
+
+void C3D_RenderTargetClear(C3D_RenderTarget* target, int bits, u32 clearColor, u32 clearDepth) { (void)target; (void)bits; (void)clearColor; (void)clearDepth; }
+void C3D_RenderTargetSetOutput(C3D_RenderTarget* target, gfxScreen_t screen, gfx3dSide_t side, u32 transferFlags) { (void)target; (void)screen; (void)side; (void)transferFlags; }
+
+DVLB_s* DVLB_ParseFile(u32* shbinData, u32 shbinSize)
+{
+	(void)shbinData;
+	(void)shbinSize;
+	static DVLE_s s_dvle;
+	static DVLB_s s_dvlb = { 1, &s_dvle };
+	return &s_dvlb;
+}
+
+void DVLB_Free(DVLB_s* dvlb) { (void)dvlb; }
+void shaderProgramInit(shaderProgram_s* sp) { sp->vertexShader = NULL; }
+void shaderProgramSetVsh(shaderProgram_s* sp, DVLE_s* dvle) { (void)sp; (void)dvle; }
+void shaderProgramFree(shaderProgram_s* sp) { (void)sp; }
+int shaderInstanceGetUniformLocation(void* si, const char* name) { (void)si; (void)name; return 0; }
+
+void AttrInfo_Init(C3D_AttrInfo* info) { (void)info; }
+int AttrInfo_AddLoader(C3D_AttrInfo* info, int regId, int format, int count) { (void)info; (void)format; (void)count; return regId; }
+void BufInfo_Init(C3D_BufInfo* info) { (void)info; }
+int BufInfo_Add(C3D_BufInfo* info, const void* data, ptrdiff_t stride, int attribCount, u64 permutation) { (void)info; (void)data; (void)stride; (void)attribCount; (void)permutation; return 0; }
+
+void Mtx_Identity(C3D_Mtx* out)
+{
+	memset(out, 0, sizeof(C3D_Mtx));
+	out->r[0].x = out->r[1].y = out->r[2].z = out->r[3].w = 1.0f;
+}
+
+void Mtx_Copy(C3D_Mtx* out, const C3D_Mtx* in) { *out = *in; }
+void Mtx_Multiply(C3D_Mtx* out, const C3D_Mtx* a, const C3D_Mtx* b) { (void)a; (void)b; Mtx_Identity(out); }
+void Mtx_Translate(C3D_Mtx* mtx, float x, float y, float z, bool bRightSide) { (void)mtx; (void)x; (void)y; (void)z; (void)bRightSide; }
+void Mtx_Scale(C3D_Mtx* mtx, float x, float y, float z) { (void)mtx; (void)x; (void)y; (void)z; }
+void Mtx_RotateZ(C3D_Mtx* mtx, float angle, bool bRightSide) { (void)mtx; (void)angle; (void)bRightSide; }
+void Mtx_Ortho(C3D_Mtx* mtx, float l, float r, float b, float t, float n, float f, bool lh) { (void)l; (void)r; (void)b; (void)t; (void)n; (void)f; (void)lh; Mtx_Identity(mtx); }
+void Mtx_OrthoTilt(C3D_Mtx* mtx, float l, float r, float b, float t, float n, float f, bool lh) { (void)l; (void)r; (void)b; (void)t; (void)n; (void)f; (void)lh; Mtx_Identity(mtx); }
+
+Tex3DS_Texture Tex3DS_TextureImport(const void* input, size_t insize, C3D_Tex* tex, void* texcube, bool vram) { (void)input; (void)insize; (void)tex; (void)texcube; (void)vram; return NULL; }
+Tex3DS_Texture Tex3DS_TextureImportFD(int fd, C3D_Tex* tex, void* texcube, bool vram) { (void)fd; (void)tex; (void)texcube; (void)vram; return NULL; }
+Tex3DS_Texture Tex3DS_TextureImportStdio(FILE* fp, C3D_Tex* tex, void* texcube, bool vram) { (void)fp; (void)tex; (void)texcube; (void)vram; return NULL; }
+void Tex3DS_TextureFree(Tex3DS_Texture texture) { (void)texture; }
+size_t Tex3DS_GetNumSubTextures(const Tex3DS_Texture texture) { (void)texture; return 0; }
+const Tex3DS_SubTexture* Tex3DS_GetSubTexture(const Tex3DS_Texture texture, size_t index) { (void)texture; (void)index; return NULL; }
+
+// Fonts
+
+#define HOST_CELL_W     20
+#define HOST_CELL_H     24
+#define HOST_SHEET_SIZE 128
+#define HOST_ROWS       6 // Glyphs per line of a sheet: each cell is followed by a separator texel
+#define HOST_LINES      5
+#define HOST_PER_SHEET  (HOST_ROWS*HOST_LINES)
+#define HOST_SHEETS     ((HOST_FONT_GLYPHS + HOST_PER_SHEET - 1) / HOST_PER_SHEET)
+
+static const u16 s_scanCodes[] = { 0x2026, 0x2190, 0x2191, 0x2192, 0x2193, 0x3001, 0x3002, 0x300C, 0x300D };
+
+static charWidthInfo_s hostGlyphWidth(int glyphIndex)
+{
+	charWidthInfo_s cwi;
+	if (glyphIndex == 1 || glyphIndex == 96) // Spaces
+	{
+		cwi.left = 0;
+		cwi.glyphWidth = 0;
+		cwi.charWidth = 6;
+	} else
+	{
+		cwi.left = glyphIndex%3 - 1;
+		cwi.glyphWidth = 8 + glyphIndex%9;
+		cwi.charWidth = cwi.glyphWidth + 1 + glyphIndex%2;
+	}
+	return cwi;
+}
+
+u8 hostFontTexel(int glyphIndex, u32 x, u32 y)
+{
+	if (x >= hostGlyphWidth(glyphIndex).glyphWidth || y >= HOST_CELL_H)
+		return 0;
+	return 1 + (glyphIndex*7 + x + 3*y) % 15;
+}
+
+u32 hostTexelIndex(u32 x, u32 y, u32 width)
+{
+	u32 morton = (x&1) | ((y&1)<<1) | ((x&2)<<1) | ((y&2)<<2) | ((x&4)<<2) | ((y&4)<<3);
+	return (((y>>3)*(width>>3) + (x>>3)) << 6) | morton;
+}
+
+static inline size_t hostAlign(size_t offset, size_t alignment)
+{
+	return (offset + alignment - 1) &~ (alignment - 1);
+}
+
+static CMAP_s* hostAddDirectCmap(u8* data, size_t* offset, u16 codeBegin, u16 codeEnd, u16 indexOffset)
+{
+	CMAP_s* cmap = (CMAP_s*)(data + *offset);
+	cmap->codeBegin = codeBegin;
+	cmap->codeEnd = codeEnd;
+	cmap->mappingMethod = CMAP_TYPE_DIRECT;
+	cmap->indexOffset = indexOffset;
+	*offset = hostAlign(*offset + sizeof(CMAP_s), 8);
+	cmap->next = (CMAP_s*)*offset; // Offset of the next one, fixed up by fontFixPointers
+	return cmap;
+}
+
+void* hostFontCreate(size_t* size)
+{
+	size_t numScan = sizeof(s_scanCodes)/sizeof(s_scanCodes[0]);
+	size_t tglpOffset = hostAlign(sizeof(CFNT_s), 8);
+	size_t cwdhOffset = hostAlign(tglpOffset + sizeof(TGLP_s), 8);
+	size_t cmapOffset = hostAlign(cwdhOffset + sizeof(CWDH_s) + HOST_FONT_GLYPHS*sizeof(charWidthInfo_s), 8);
+	size_t sheetOffset = hostAlign(cmapOffset + 4*sizeof(CMAP_s) + numScan*4 + 64, 0x80);
+	size_t sheetSize = HOST_SHEET_SIZE*HOST_SHEET_SIZE/2;
+	*size = sheetOffset + HOST_SHEETS*sheetSize;
+
+	u8* data = (u8*)linearAlloc(*size);
+	if (!data)
+		return NULL;
+	memset(data, 0, *size);
+
+	CFNT_s* cfnt = (CFNT_s*)data;
+	memcpy(&cfnt->signature, "CFNT", 4);
+	cfnt->endianness = 0xFEFF;
+	cfnt->headerSize = 0x14;
+	cfnt->version = 0x03000000;
+	cfnt->fileSize = *size;
+	cfnt->nBlocks = 4;
+
+	FINF_s* finf = &cfnt->finf;
+	memcpy(&finf->signature, "FINF", 4);
+	finf->fontType = 1;
+	finf->lineFeed = 26;
+	finf->alterCharIndex = 0;
+	finf->defaultWidth = hostGlyphWidth(0);
+	finf->encoding = 1;
+	finf->tglp = (TGLP_s*)tglpOffset;
+	finf->cwdh = (CWDH_s*)cwdhOffset;
+	finf->cmap = (CMAP_s*)cmapOffset;
+	finf->height = 26;
+	finf->width = HOST_CELL_W;
+	finf->ascent = 20;
+
+	TGLP_s* tglp = (TGLP_s*)(data + tglpOffset);
+	tglp->cellWidth = HOST_CELL_W;
+	tglp->cellHeight = HOST_CELL_H;
+	tglp->baselinePos = 20;
+	tglp->maxCharWidth = HOST_CELL_W;
+	tglp->sheetSize = sheetSize;
+	tglp->nSheets = HOST_SHEETS;
+	tglp->sheetFmt = GPU_A4;
+	tglp->nRows = HOST_ROWS;
+	tglp->nLines = HOST_LINES;
+	tglp->sheetWidth = HOST_SHEET_SIZE;
+	tglp->sheetHeight = HOST_SHEET_SIZE;
+	tglp->sheetData = (u8*)sheetOffset;
+
+	CWDH_s* cwdh = (CWDH_s*)(data + cwdhOffset);
+	cwdh->startIndex = 0;
+	cwdh->endIndex = HOST_FONT_GLYPHS - 1;
+	cwdh->next = NULL;
+	int i;
+	for (i = 0; i < HOST_FONT_GLYPHS; i ++)
+		cwdh->widths[i] = hostGlyphWidth(i);
+
+	size_t offset = cmapOffset;
+	hostAddDirectCmap(data, &offset, 0x20, 0x7E, 1);
+	hostAddDirectCmap(data, &offset, 0xA0, 0xFF, 96);
+	hostAddDirectCmap(data, &offset, 0x4E00, 0x51FF, 192);
+	CMAP_s* scan = (CMAP_s*)(data + offset);
+	scan->codeBegin = s_scanCodes[0];
+	scan->codeEnd = s_scanCodes[numScan-1];
+	scan->mappingMethod = CMAP_TYPE_SCAN;
+	scan->nScanEntries = numScan;
+	scan->next = NULL;
+	for (i = 0; i < (int)numScan; i ++)
+	{
+		scan->scanEntries[i].code = s_scanCodes[i];
+		scan->scanEntries[i].glyphIndex = 1216 + i;
+	}
+
+	// Glyphs are where fontCalcGlyphPos expects them, with rows going upwards in memory
+	for (i = 0; i < HOST_FONT_GLYPHS; i ++)
+	{
+		u8* sheet = data + sheetOffset + (i / HOST_PER_SHEET)*sheetSize;
+		u32 line = i % HOST_PER_SHEET / HOST_ROWS, row = i % HOST_ROWS;
+		u32 glyphX = row*(HOST_CELL_W+1) + 1;
+		u32 glyphY = HOST_SHEET_SIZE - (line+1)*(HOST_CELL_H+1) - 1;
+		u32 x, y;
+		for (y = 0; y < HOST_CELL_H; y ++)
+			for (x = 0; x < HOST_CELL_W; x ++)
+			{
+				u32 index = hostTexelIndex(glyphX + x, glyphY + y, HOST_SHEET_SIZE);
+				sheet[index>>1] |= hostFontTexel(i, x, y) << ((index&1)*4);
+			}
+	}
+	return data;
+}
+
+void fontFixPointers(CFNT_s* font)
+{
+	uintptr_t base = (uintptr_t)font;
+	font->finf.tglp = (TGLP_s*)((uintptr_t)font->finf.tglp + base);
+	font->finf.tglp->sheetData = (u8*)((uintptr_t)font->finf.tglp->sheetData + base);
+
+	CMAP_s** cmap;
+	for (cmap = &font->finf.cmap; *cmap; cmap = &(*cmap)->next)
+		*cmap = (CMAP_s*)((uintptr_t)*cmap + base);
+	CWDH_s** cwdh;
+	for (cwdh = &font->finf.cwdh; *cwdh; cwdh = &(*cwdh)->next)
+		*cwdh = (CWDH_s*)((uintptr_t)*cwdh + base);
+}
+
+static CFNT_s* s_systemFont;
+
+Result fontEnsureMapped(void)
+{
+	if (!s_systemFont)
+	{
+		size_t size;
+		CFNT_s* font = (CFNT_s*)hostFontCreate(&size);
+		if (!font)
+			return -1;
+		fontFixPointers(font);
+		s_systemFont = font;
+	}
+	return 0;
+}
+
+CFNT_s* fontGetSystemFont(void)
+{
+	if (!s_systemFont)
+		fontEnsureMapped();
+	return s_systemFont;
+}
+
+int fontGlyphIndexFromCodePoint(CFNT_s* font, u32 codePoint)
+{
+	if (!font)
+		font = fontGetSystemFont();
+	int ret = font->finf.alterCharIndex;
+	if (codePoint >= 0x10000)
+		return ret;
+
+	CMAP_s* cmap;
+	for (cmap = font->finf.cmap; cmap; cmap = cmap->next)
+	{
+		if (codePoint < cmap->codeBegin || codePoint > cmap->codeEnd)
+			continue;
+		if (cmap->mappingMethod == CMAP_TYPE_DIRECT)
+			return cmap->indexOffset + (codePoint - cmap->codeBegin);
+		if (cmap->mappingMethod == CMAP_TYPE_TABLE)
+			return cmap->indexTable[codePoint - cmap->codeBegin];
+
+		int j;
+		for (j = 0; j < cmap->nScanEntries; j ++)
+			if (cmap->scanEntries[j].code == codePoint)
+				return cmap->scanEntries[j].glyphIndex;
+	}
+	return ret;
+}
+
+charWidthInfo_s* fontGetCharWidthInfo(CFNT_s* font, int glyphIndex)
+{
+	if (!font)
+		font = fontGetSystemFont();
+	CWDH_s* cwdh;
+	for (cwdh = font->finf.cwdh; cwdh; cwdh = cwdh->next)
+		if (glyphIndex >= cwdh->startIndex && glyphIndex <= cwdh->endIndex)
+			return &cwdh->widths[glyphIndex - cwdh->startIndex];
+	return &font->finf.defaultWidth;
+}
+
+void fontCalcGlyphPos(fontGlyphPos_s* out, CFNT_s* font, int glyphIndex, u32 flags, float scaleX, float scaleY)
+{
+	(void)flags;
+	if (!font)
+		font = fontGetSystemFont();
+	TGLP_s* tglp = font->finf.tglp;
+	charWidthInfo_s* cwi = fontGetCharWidthInfo(font, glyphIndex);
+
+	int glyphsPerSheet = tglp->nRows*tglp->nLines;
+	int sheetGlyph = glyphIndex % glyphsPerSheet;
+	out->sheetIndex = glyphIndex / glyphsPerSheet;
+	out->xOffset  = scaleX*cwi->left;
+	out->xAdvance = scaleX*cwi->charWidth;
+	out->width    = scaleX*cwi->glyphWidth;
+
+	int lineId = sheetGlyph / tglp->nRows;
+	int rowId  = sheetGlyph % tglp->nRows;
+	float tx = (float)(rowId*(tglp->cellWidth+1)+1) / tglp->sheetWidth;
+	float ty = 1.0f - (float)((lineId+1)*(tglp->cellHeight+1)+1) / tglp->sheetHeight;
+	float tw = (float)cwi->glyphWidth / tglp->sheetWidth;
+	float th = (float)tglp->cellHeight / tglp->sheetHeight;
+	out->texcoord.left   = tx;
+	out->texcoord.top    = ty+th;
+	out->texcoord.right  = tx+tw;
+	out->texcoord.bottom = ty;
+
+	out->vtxcoord.left   = 0.0f;
+	out->vtxcoord.top    = 0.0f;
+	out->vtxcoord.right  = scaleX*cwi->glyphWidth;
+	out->vtxcoord.bottom = scaleY*tglp->cellHeight;
+}
@@ -0,0 +1,28 @@
+// Helpers for the host tests, on top of the libctru and citro3d stand-ins in citro3d.h
+#pragma once
+#include <citro3d.h>
+
+// The system font is synthetic: 30 glyphs per 128x128 A4 sheet, in 20x24 cells. Its glyphs are
+//   0                  replacement glyph
+//   1-95               U+0020-U+007E (direct CMAP), the space has no glyph
+//   96-191             U+00A0-U+00FF (direct CMAP), the no-break space has no glyph
+//   192-1215           U+4E00-U+51FF (direct CMAP)
+//   1216-1224          a few punctuation marks and arrows (scan CMAP)
+#define HOST_FONT_GLYPHS 1225
+
+// Creates a copy of the synthetic font as it is stored in a file (pointers are offsets from the start, see
+// fontFixPointers), allocated with linearAlloc. Can be passed to C2D_FontLoadFromMem or C2D_FontAdoptMem.
+void* hostFontCreate(size_t* size);
+
+// Value of a texel of a glyph of the synthetic font, x to the right and y upwards from its bottom left corner
+u8 hostFontTexel(int glyphIndex, u32 x, u32 y);
+
+// Index of a texel in a tiled texture, for looking into glyph sheets and other textures
+u32 hostTexelIndex(u32 x, u32 y, u32 width);
+
+// Number of draw calls and texture binds issued so far
+extern u32 hostDrawCalls;
+extern u32 hostTexBinds;
+
+// Monotonic time in seconds
+double hostTime(void);
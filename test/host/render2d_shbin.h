@@ -0,0 +1,5 @@
+// Host stand-in for the shader binary that the 3DS build embeds, the shader is never run on the host
+#pragma once
+
+extern const unsigned char render2d_shbin[];
+extern const unsigned int render2d_shbin_size;
@@ -0,0 +1,42 @@
+// Host stand-in for tex3ds, see citro3d.h
+#pragma once
+#include "citro3d.h"
+
+typedef struct
+{
+	u16 width, height;
+	float left, top, right, bottom;
+} Tex3DS_SubTexture;
+
+typedef struct Tex3DS_Texture_s* Tex3DS_Texture;
+
+Tex3DS_Texture Tex3DS_TextureImport(const void* input, size_t insize, C3D_Tex* tex, void* texcube, bool vram);
+Tex3DS_Texture Tex3DS_TextureImportFD(int fd, C3D_Tex* tex, void* texcube, bool vram);
+Tex3DS_Texture Tex3DS_TextureImportStdio(FILE* fp, C3D_Tex* tex, void* texcube, bool vram);
+void Tex3DS_TextureFree(Tex3DS_Texture texture);
+size_t Tex3DS_GetNumSubTextures(const Tex3DS_Texture texture);
+const Tex3DS_SubTexture* Tex3DS_GetSubTexture(const Tex3DS_Texture texture, size_t index);
+
+static inline void Tex3DS_SubTextureTopLeft(const Tex3DS_SubTexture* sub, float* u, float* v)
+{
+	*u = sub->left;
+	*v = sub->top;
+}
+
+static inline void Tex3DS_SubTextureTopRight(const Tex3DS_SubTexture* sub, float* u, float* v)
+{
+	*u = sub->right;
+	*v = sub->top;
+}
+
+static inline void Tex3DS_SubTextureBottomLeft(const Tex3DS_SubTexture* sub, float* u, float* v)
+{
+	*u = sub->left;
+	*v = sub->bottom;
+}
+
+static inline void Tex3DS_SubTextureBottomRight(const Tex3DS_SubTexture* sub, float* u, float* v)
+{
+	*u = sub->right;
+	*v = sub->bottom;
+}
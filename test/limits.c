@@ -0,0 +1,68 @@
+// Checks that parsing stops at the most lines and words per line that a text object can hold,
+// and that the last line can still be found when drawing part of the text.
+#include <citro2d.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "internal.h"
+
+#define MAX_LINES 65536
+#define MAX_WORDS 65536
+#define REPEATS   70000
+
+static char* repeat(const char* piece)
+{
+	size_t len = strlen(piece);
+	char* str = (char*)malloc(REPEATS*len + 1);
+	int i;
+	for (i = 0; i < REPEATS; i ++)
+		memcpy(str + i*len, piece, len);
+	str[REPEATS*len] = 0;
+	return str;
+}
+
+int main(void)
+{
+	C2D_Init(64);
+	C2D_Prepare();
+	C2D_TextBuf buf = C2D_TextBufNew(REPEATS);
+	C2D_Text text;
+	int failures = 0;
+
+	char* str = repeat("a\n");
+	const char* end = C2D_TextParse(&text, buf, str);
+	if (text.lines != MAX_LINES || text.end - text.begin != MAX_LINES || end != str + 2*MAX_LINES - 1)
+	{
+		printf("lines: %lu lines, %zu glyphs, stopped at %td\n", (unsigned long)text.lines, text.end - text.begin, end - str);
+		failures++;
+	}
+
+	// Only the last line is within the clip rectangle
+	float lineHeight;
+	C2D_TextGetDimensions(&text, 1.0f, 1.0f, NULL, &lineHeight);
+	lineHeight /= text.lines;
+	C2Di_Context* ctx = C2Di_GetContext();
+	ctx->vtxBufPos = ctx->idxBufPos = ctx->idxBufLastPos = 0;
+	C2D_DrawText(&text, C2D_WithClip, 0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 0.0f, (MAX_LINES-0.5f)*lineHeight, 100.0f, 4.0f);
+	if (ctx->vtxBufPos != 4 || ctx->vtxBuf[0].pos[1] < (MAX_LINES-1)*lineHeight)
+	{
+		printf("lines: %zu vertices drawn for the last line\n", ctx->vtxBufPos);
+		failures++;
+	}
+	free(str);
+
+	C2D_TextBufClear(buf);
+	str = repeat("a ");
+	end = C2D_TextParse(&text, buf, str);
+	if (text.lines != 1 || text.words != MAX_WORDS || text.end - text.begin != MAX_WORDS || end != str + 2*MAX_WORDS)
+	{
+		printf("words: %lu words, %zu glyphs, stopped at %td\n", (unsigned long)text.words, text.end - text.begin, end - str);
+		failures++;
+	}
+	free(str);
+
+	C2D_TextBufDelete(buf);
+	C2D_Fini();
+	return failures ? 1 : 0;
+}
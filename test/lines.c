@@ -0,0 +1,103 @@
+// Checks that drawing a text object in ranges of lines gives the same quads as drawing it whole, with every
+// alignment, with and without wrapping, for text large enough that its layout doesn't fit on the stack.
+#include <citro2d.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "internal.h"
+
+#define NUM_LINES  300
+#define LINE_WORDS 8
+#define WRAP_WIDTH 150.0f
+
+static int compareVertex(const void* a, const void* b)
+{
+	return memcmp(a, b, sizeof(C2Di_Vertex));
+}
+
+// Appends the quads of a range of lines to vertices
+static size_t drawLines(const C2D_Text* text, u32 flags, u32 firstLine, u32 numLines, C2Di_Vertex* vertices)
+{
+	C2Di_Context* ctx = C2Di_GetContext();
+	C2D_Prepare();
+	ctx->vtxBufPos = ctx->idxBufPos = ctx->idxBufLastPos = 0;
+	if (!C2D_DrawTextLines(text, flags, firstLine, numLines, 10.0f, 20.0f, 0.5f, 0.75f, 0.75f, WRAP_WIDTH))
+		return 0;
+	C2D_Flush();
+	memcpy(vertices, ctx->vtxBuf, ctx->vtxBufPos*sizeof(C2Di_Vertex));
+	return ctx->vtxBufPos;
+}
+
+static int check(const char* name, const C2D_Text* text, u32 flags, C2Di_Vertex* whole, C2Di_Vertex* parts)
+{
+	size_t numWhole = drawLines(text, flags, 0, UINT32_MAX, whole);
+	if (!numWhole)
+	{
+		printf("%s %#lx: nothing drawn\n", name, (unsigned long)flags);
+		return 1;
+	}
+
+	// Lines past the end of the text, and ranges that end past it, are fine
+	static const u32 ranges[][2] = { { 0, 100 }, { 100, 1 }, { 101, 199 }, { 300, UINT32_MAX }, { 5000, 10 } };
+	size_t numParts = 0, i;
+	for (i = 0; i < sizeof(ranges)/sizeof(ranges[0]); i ++)
+		numParts += drawLines(text, flags, ranges[i][0], ranges[i][1], parts + numParts);
+
+	qsort(whole, numWhole, sizeof(C2Di_Vertex), compareVertex);
+	qsort(parts, numParts, sizeof(C2Di_Vertex), compareVertex);
+	if (numParts != numWhole || memcmp(whole, parts, numWhole*sizeof(C2Di_Vertex)) != 0)
+	{
+		printf("%s %#lx: ranges of lines aren't drawn like the whole text (%zu and %zu vertices)\n", name, (unsigned long)flags, numParts, numWhole);
+		return 1;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	static const char* const words[] = { "lorem", "ipsum", "dolor", "sit", "amet,", "consectetur", "adipiscing", "elit" };
+	size_t cap = NUM_LINES*LINE_WORDS*16, numChars = 0;
+	char* str = (char*)malloc(cap);
+	char* p = str;
+	int line, word;
+	for (line = 0; line < NUM_LINES; line ++)
+		for (word = 0; word < LINE_WORDS; word ++)
+		{
+			// Lines of different lengths, so that alignment moves them differently
+			if (word > LINE_WORDS/2 && (line + word) % 3 == 0)
+				continue;
+			const char* w = words[(line*3 + word) % LINE_WORDS];
+			p += sprintf(p, "%s%c", w, word + 1 < LINE_WORDS ? ' ' : '\n');
+			numChars += strlen(w);
+		}
+	*p = 0;
+
+	C2D_Init(numChars);
+	C2D_TextBuf buf = C2D_TextBufNew(2*numChars);
+	C2D_Text text, optimized;
+	C2D_TextParse(&text, buf, str);
+	C2D_TextFontParseEx(&optimized, NULL, buf, str, C2D_ParseOptimize);
+
+	C2Di_Vertex* whole = (C2Di_Vertex*)malloc(4*numChars*sizeof(C2Di_Vertex));
+	C2Di_Vertex* parts = (C2Di_Vertex*)malloc(4*numChars*sizeof(C2Di_Vertex));
+	static const u32 flags[] =
+	{
+		C2D_AlignLeft, C2D_AlignRight, C2D_AlignCenter, C2D_AlignJustified,
+		C2D_WordWrap, C2D_WordWrap|C2D_AlignRight, C2D_WordWrap|C2D_AlignCenter, C2D_WordWrap|C2D_AlignJustified,
+	};
+	int failures = 0;
+	size_t i;
+	for (i = 0; i < sizeof(flags)/sizeof(flags[0]); i ++)
+	{
+		failures += check("text", &text, flags[i], whole, parts);
+		failures += check("optimized", &optimized, flags[i], whole, parts);
+	}
+
+	free(parts);
+	free(whole);
+	free(str);
+	C2D_TextBufDelete(buf);
+	C2D_Fini();
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,166 @@
+// Compresses data that looks like glyph sheets and font tables with a simple LZ11 encoder, then checks
+// that C2Di_DecompressLZ11 gives the same output as libctru's decompress_LZ11.
+#include <citro2d.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "internal.h"
+
+#define WINDOW   0x1000
+#define MAX_LEN  0x10110
+#define HASH_LEN 0x10000
+
+static u32 s_seed = 1;
+
+static u32 nextRandom(void)
+{
+	s_seed = s_seed*1103515245 + 12345;
+	return s_seed >> 16;
+}
+
+// Greedy encoder, looking for matches at the last position with the same three bytes and right behind
+static size_t compress(u8* out, const u8* in, size_t size)
+{
+	static u32 lastPos[HASH_LEN];
+	memset(lastPos, 0xFF, sizeof(lastPos));
+
+	size_t outPos = 0, pos = 0, flagPos = 0;
+	int block = 8;
+	while (pos < size)
+	{
+		if (block == 8)
+		{
+			flagPos = outPos;
+			out[outPos++] = 0;
+			block = 0;
+		}
+
+		size_t bestLen = 0, bestDisp = 0, maxLen = size - pos < MAX_LEN ? size - pos : MAX_LEN;
+		size_t candidates[2] = { pos - 1, 0 };
+		int numCandidates = pos ? 1 : 0;
+		u32 hash = 0;
+		if (pos + 3 <= size)
+		{
+			hash = (in[pos] << 8 ^ in[pos+1] << 4 ^ in[pos+2]) & (HASH_LEN-1);
+			if (lastPos[hash] != 0xFFFFFFFF && pos - lastPos[hash] <= WINDOW)
+				candidates[numCandidates++] = lastPos[hash];
+		}
+
+		int i;
+		for (i = 0; i < numCandidates; i ++)
+		{
+			size_t len = 0;
+			while (len < maxLen && in[candidates[i] + len] == in[pos + len])
+				len++;
+			if (len > bestLen)
+			{
+				bestLen  = len;
+				bestDisp = pos - candidates[i];
+			}
+		}
+		if (pos + 3 <= size)
+			lastPos[hash] = pos;
+
+		if (bestLen < 3)
+		{
+			out[outPos++] = in[pos++];
+			block++;
+			continue;
+		}
+
+		size_t disp = bestDisp - 1;
+		out[flagPos] |= 0x80 >> block++;
+		if (bestLen <= 0x10)
+		{
+			out[outPos++] = (bestLen-1) << 4 | disp >> 8;
+		} else if (bestLen <= 0x110)
+		{
+			out[outPos++] = (bestLen-0x11) >> 4;
+			out[outPos++] = ((bestLen-0x11) & 0xF) << 4 | disp >> 8;
+		} else
+		{
+			out[outPos++] = 0x10 | (bestLen-0x111) >> 12;
+			out[outPos++] = (bestLen-0x111) >> 4;
+			out[outPos++] = ((bestLen-0x111) & 0xF) << 4 | disp >> 8;
+		}
+		out[outPos++] = disp;
+		pos += bestLen;
+	}
+	return outPos;
+}
+
+static bool decompress(const u8* in, size_t inSize, u8* out, size_t size)
+{
+	FILE* f = fmemopen((void*)in, inSize, "rb");
+	bool ret = C2Di_DecompressLZ11(f, out, size);
+	fclose(f);
+	return ret;
+}
+
+static int check(const char* name, const u8* data, size_t size)
+{
+	u8* packed = (u8*)calloc(size*9/8 + 16, 1);
+	u8* out = (u8*)malloc(size);
+	u8* ref = (u8*)malloc(size);
+	size_t packedSize = compress(packed, data, size);
+
+	int ret = 0;
+	bool ok = decompress(packed, packedSize, out, size);
+	bool refOk = decompress_LZ11(ref, size, NULL, packed, packedSize);
+	if (!ok || !refOk || memcmp(out, ref, size) != 0 || memcmp(out, data, size) != 0)
+	{
+		printf("%s: decompressed data differs\n", name);
+		ret = 1;
+	}
+
+	// Truncated data must be rejected
+	if (decompress(packed, packedSize/2, out, size))
+	{
+		printf("%s: truncated data accepted\n", name);
+		ret = 1;
+	}
+
+	printf("%s: %zu bytes, %zu compressed\n", name, size, packedSize);
+	free(packed);
+	free(out);
+	free(ref);
+	return ret;
+}
+
+int main(void)
+{
+	int failures = 0;
+
+	// The synthetic font: long runs of zeros, repeated glyph rows and tables
+	size_t size;
+	void* font = hostFontCreate(&size);
+	failures += check("font", (const u8*)font, size);
+	linearFree(font);
+
+	// Short and long matches at every distance, mixed with literals
+	size = 300000;
+	u8* data = (u8*)malloc(size);
+	size_t pos = 0;
+	while (pos < size)
+	{
+		size_t len = nextRandom() % 3 == 0 ? nextRandom() % 0x300 : nextRandom() % 20;
+		size_t disp = 1 + nextRandom() % WINDOW;
+		size_t i;
+		for (i = 0; i < len && pos < size; i ++, pos ++)
+			data[pos] = pos >= disp && nextRandom() % 64 ? data[pos - disp] : nextRandom();
+	}
+	failures += check("random", data, size);
+
+	// References to data before the start of the output must be rejected
+	static const u8 badRef[] = { 0x40, 'a', 0x20, 0x01 };
+	u8 out[8];
+	if (decompress(badRef, sizeof(badRef), out, sizeof(out)))
+	{
+		printf("Reference before the start accepted\n");
+		failures++;
+	}
+
+	free(data);
+	return failures ? 1 : 0;
+}
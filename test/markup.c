@@ -0,0 +1,80 @@
+// Checks that C2D_TextUpdate keeps interpreting color markup in text objects parsed with C2D_ParseColorMarkup,
+// and that the glyphs it keeps or re-parses have the same colors as when parsing the new string from scratch.
+#include <citro2d.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "internal.h"
+
+#define MAX_VERTICES 1024
+
+static size_t draw(const C2D_Text* text, C2Di_Vertex* vertices)
+{
+	C2Di_Context* ctx = C2Di_GetContext();
+	C2D_Prepare();
+	ctx->vtxBufPos = ctx->idxBufPos = ctx->idxBufLastPos = 0;
+	C2D_DrawText(text, C2D_WithColor, 10.0f, 20.0f, 0.5f, 1.0f, 1.0f, C2D_Color32(0x10, 0x20, 0x30, 0xFF));
+	C2D_Flush();
+	memcpy(vertices, ctx->vtxBuf, ctx->vtxBufPos*sizeof(C2Di_Vertex));
+	return ctx->vtxBufPos;
+}
+
+// Updates a text object with each string in turn, comparing it with the string parsed from scratch
+static int checkUpdates(const char* name, u32 flags, const char* const* strs, size_t numStrs)
+{
+	static C2Di_Vertex updated[MAX_VERTICES], parsed[MAX_VERTICES];
+	C2D_TextBuf buf = C2D_TextBufNew(256), refBuf = C2D_TextBufNew(256);
+	C2D_Text text, ref;
+	int ret = 0;
+	size_t i;
+
+	C2D_TextFontParseEx(&text, NULL, buf, strs[0], flags);
+	for (i = 1; i < numStrs; i ++)
+	{
+		C2D_TextUpdate(&text, strs[i]);
+		C2D_TextBufClear(refBuf);
+		C2D_TextFontParseEx(&ref, NULL, refBuf, strs[i], flags & ~C2D_ParseOptimize);
+
+		size_t numUpdated = draw(&text, updated), numParsed = draw(&ref, parsed);
+		if (numUpdated != numParsed || memcmp(updated, parsed, numParsed*sizeof(C2Di_Vertex)) != 0
+			|| text.width != ref.width || text.lines != ref.lines || text.words != ref.words)
+		{
+			printf("%s: \"%s\" isn't the same after updating\n", name, strs[i]);
+			ret = 1;
+		}
+	}
+
+	C2D_TextBufDelete(refBuf);
+	C2D_TextBufDelete(buf);
+	return ret;
+}
+
+int main(void)
+{
+	C2D_Init(MAX_VERTICES/4);
+	C2D_Prepare();
+
+	static const char* const colors[] =
+	{
+		"a{#FF0000}bc{#}d",
+		"a{#FF0000}bcX{#}d",  // Resumes after a red glyph
+		"a{#FF0000}bcX{#}dY", // Resumes after a glyph without markup color
+		"a{#FF0000}bcX{#00FF0080}Z",
+		"a{#FF0000}b{#00FF0080}Z",
+		"a{{b{#0000FF}c\nd{#}e f", // Literal brace, and markup carried over to the next line
+		"a{{b{#0000FF}c\nd{#}e fg",
+		"{#0000FF}12:34",
+		"{#0000FF}12:35",
+	};
+	int ret = 0;
+	ret |= checkUpdates("markup", C2D_ParseColorMarkup, colors, sizeof(colors)/sizeof(colors[0]));
+	ret |= checkUpdates("optimized markup", C2D_ParseColorMarkup|C2D_ParseOptimize, colors, sizeof(colors)/sizeof(colors[0]));
+
+	// Without the flag, braces are plain glyphs
+	static const char* const plain[] = { "a{#FF0000}b", "a{#FF0000}bc", "{#}" };
+	ret |= checkUpdates("plain", 0, plain, sizeof(plain)/sizeof(plain[0]));
+
+	C2D_Fini();
+	return ret;
+}
@@ -0,0 +1,121 @@
+// Checks that optimized text objects are drawn with one texture switch per glyph sheet, and that
+// optimizing only changes the order in which the glyphs of that text object are drawn.
+#include <citro2d.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "internal.h"
+
+#define NUM_CHARS 600
+
+static int compareVertex(const void* a, const void* b)
+{
+	return memcmp(a, b, sizeof(C2Di_Vertex));
+}
+
+// Draws lines of a text object, returns the number of texture switches and the sorted vertices in *vertices
+static u32 drawLines(const C2D_Text* text, u32 firstLine, u32 numLines, C2Di_Vertex** vertices, size_t* numVertices)
+{
+	C2Di_Context* ctx = C2Di_GetContext();
+	C2D_Prepare();
+	ctx->vtxBufPos = ctx->idxBufPos = ctx->idxBufLastPos = 0;
+
+	u32 binds = hostTexBinds;
+	C2D_DrawTextLines(text, 0, firstLine, numLines, 10.0f, 20.0f, 0.5f, 0.75f, 0.75f);
+	C2D_Flush();
+	binds = hostTexBinds - binds;
+
+	*numVertices = ctx->vtxBufPos;
+	*vertices = (C2Di_Vertex*)malloc(ctx->vtxBufPos*sizeof(C2Di_Vertex));
+	memcpy(*vertices, ctx->vtxBuf, ctx->vtxBufPos*sizeof(C2Di_Vertex));
+	qsort(*vertices, *numVertices, sizeof(C2Di_Vertex), compareVertex);
+	return binds;
+}
+
+static int check(const char* name, const C2D_Text* text, u32 firstLine, u32 numLines, u32 numSheets, const C2Di_Vertex* refVertices, size_t refNumVertices)
+{
+	C2Di_Vertex* vertices;
+	size_t numVertices;
+	u32 binds = drawLines(text, firstLine, numLines, &vertices, &numVertices);
+
+	int ret = 0;
+	if (numSheets && binds != numSheets)
+	{
+		printf("%s: %lu texture switches for %lu sheets\n", name, (unsigned long)binds, (unsigned long)numSheets);
+		ret = 1;
+	}
+	if (numVertices != refNumVertices || memcmp(vertices, refVertices, numVertices*sizeof(C2Di_Vertex)) != 0)
+	{
+		printf("%s: the glyphs aren't drawn the same\n", name);
+		ret = 1;
+	}
+	free(vertices);
+	return ret;
+}
+
+int main(void)
+{
+	C2D_Init(4*NUM_CHARS);
+	C2D_Prepare();
+
+	// Alternate between ASCII and CJK characters spread over many sheets, over a few lines
+	char str[NUM_CHARS*3+1];
+	char* p = str;
+	bool usedSheets[64] = { false };
+	int i;
+	for (i = 0; i < NUM_CHARS; i ++)
+	{
+		u32 code;
+		if (i % 50 == 49)
+			code = '\n';
+		else if (i & 1)
+			code = 0x4E00 + (i*37) % 0x400;
+		else
+			code = 'a' + i % 26;
+		p += encode_utf8((uint8_t*)p, code);
+
+		if (code != '\n')
+		{
+			fontGlyphPos_s pos;
+			fontCalcGlyphPos(&pos, NULL, fontGlyphIndexFromCodePoint(NULL, code), 0, 1.0f, 1.0f);
+			usedSheets[pos.sheetIndex] = true;
+		}
+	}
+	*p = 0;
+
+	u32 numSheets = 0;
+	for (i = 0; i < 64; i ++)
+		numSheets += usedSheets[i];
+
+	C2D_TextBuf buf = C2D_TextBufNew(3*NUM_CHARS);
+	C2D_Text text, other, optimized;
+	C2D_TextParse(&text, buf, str);
+	C2D_TextParse(&other, buf, str);
+
+	C2Di_Vertex *refVertices, *refLineVertices;
+	size_t refNumVertices, refNumLineVertices;
+	u32 binds = drawLines(&text, 0, UINT32_MAX, &refVertices, &refNumVertices);
+	drawLines(&text, 3, 2, &refLineVertices, &refNumLineVertices);
+	printf("%lu texture switches before optimizing, %lu sheets\n", (unsigned long)binds, (unsigned long)numSheets);
+
+	int failures = 0;
+	C2D_TextOptimize(&text);
+	failures += check("C2D_TextOptimize", &text, 0, UINT32_MAX, numSheets, refVertices, refNumVertices);
+	failures += check("C2D_TextOptimize, lines", &text, 3, 2, 0, refLineVertices, refNumLineVertices);
+	failures += check("Other text", &other, 3, 2, 0, refLineVertices, refNumLineVertices);
+
+	C2D_TextFontParseEx(&optimized, NULL, buf, str, C2D_ParseOptimize);
+	failures += check("C2D_ParseOptimize", &optimized, 0, UINT32_MAX, numSheets, refVertices, refNumVertices);
+
+	// Parsing again where an optimized text object was puts the glyphs back in line order
+	C2D_TextBufClear(buf);
+	C2D_TextParse(&text, buf, str);
+	failures += check("Parsed again, lines", &text, 3, 2, 0, refLineVertices, refNumLineVertices);
+
+	free(refLineVertices);
+	free(refVertices);
+	C2D_TextBufDelete(buf);
+	C2D_Fini();
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,208 @@
+// Builds string tables the way tools/strtab.c does, checks that they load and draw like parsed text, and that
+// tables whose line and word numbers don't match their strings are rejected.
+#include <citro2d.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "internal.h"
+
+// Same layout as in source/text.c
+typedef struct
+{
+	char magic[4];
+	u16 version;
+	u16 numSheets;
+	u16 glyphsPerSheet;
+	u16 cellHeight;
+	u32 numStrings;
+	u32 numGlyphs;
+} TableHeader;
+
+typedef struct
+{
+	u32 firstGlyph;
+	u32 numGlyphs;
+	float width;
+	u32 lines;
+	u32 words;
+} TableString;
+
+typedef struct
+{
+	float xPos;
+	u16 sheet;
+	u16 sheetGlyph;
+	u16 lineNo;
+	u16 wordNo;
+	u16 width;
+	u16 reserved;
+} TableGlyph;
+
+#define MAX_GLYPHS 64
+
+typedef struct
+{
+	TableHeader header;
+	TableString string;
+	TableGlyph glyphs[MAX_GLYPHS];
+} Table;
+
+// Pre-parses an ASCII string with the system font, as tools/strtab.c does
+static size_t makeTable(Table* table, const char* str)
+{
+	TGLP_s* tglp = C2D_FontGetInfo(NULL)->tglp;
+	u32 perSheet = tglp->nRows*tglp->nLines;
+	memset(table, 0, sizeof(*table));
+	memcpy(table->header.magic, "C2ST", 4);
+	table->header.version        = 1;
+	table->header.numSheets      = tglp->nSheets;
+	table->header.glyphsPerSheet = perSheet;
+	table->header.cellHeight     = tglp->cellHeight;
+	table->header.numStrings     = 1;
+
+	TableString* s = &table->string;
+	u32 numGlyphs = 0, lineNo = 0;
+	for (;;)
+	{
+		float width = 0.0f;
+		u32 wordNum = 0;
+		bool lastWasWhitespace = true;
+		for (; *str && *str != '\n'; str ++)
+		{
+			int glyphIndex = C2D_FontGlyphIndexFromCodePoint(NULL, (u8)*str);
+			charWidthInfo_s* cw = C2D_FontGetCharWidthInfo(NULL, glyphIndex);
+			if (cw->glyphWidth > 0)
+			{
+				TableGlyph* glyph = &table->glyphs[numGlyphs++];
+				glyph->xPos       = width + cw->left;
+				glyph->sheet      = glyphIndex / perSheet;
+				glyph->sheetGlyph = glyphIndex % perSheet;
+				glyph->lineNo     = lineNo;
+				glyph->wordNo     = wordNum;
+				glyph->width      = cw->glyphWidth;
+				lastWasWhitespace = false;
+			} else if (!lastWasWhitespace)
+			{
+				wordNum++;
+				lastWasWhitespace = true;
+			}
+			width += cw->charWidth;
+		}
+		if (!lastWasWhitespace)
+			wordNum++;
+
+		s->words += wordNum;
+		s->lines = lineNo + 1;
+		if (width > s->width)
+			s->width = width;
+		if (*str != '\n')
+			break;
+		str++;
+		lineNo++;
+	}
+	s->numGlyphs = numGlyphs;
+	table->header.numGlyphs = numGlyphs;
+	return offsetof(Table, glyphs) + numGlyphs*sizeof(TableGlyph);
+}
+
+static int checkRejected(const char* name, const Table* table, size_t size)
+{
+	C2D_Text text;
+	C2D_TextBuf buf = C2D_TextTableLoad(&text, 1, NULL, table, size);
+	if (!buf)
+		return 0;
+	printf("%s: the table was loaded\n", name);
+	C2D_TextBufDelete(buf);
+	return 1;
+}
+
+int main(void)
+{
+	C2D_Init(4*MAX_GLYPHS);
+	C2D_Prepare();
+
+	static const char str[] = "ab cd  e\n\nfg h\n";
+	static Table table, bad;
+	size_t size = makeTable(&table, str);
+	int failures = 0;
+
+	// A valid table loads, and draws with every layout like the parsed string
+	C2D_Text text, ref;
+	C2D_TextBuf buf = C2D_TextTableLoad(&text, 1, NULL, &table, size);
+	C2D_TextBuf refBuf = C2D_TextBufNew(MAX_GLYPHS);
+	C2D_TextParse(&ref, refBuf, str);
+	if (!buf)
+	{
+		printf("valid: the table wasn't loaded\n");
+		failures++;
+	} else
+	{
+		if (text.lines != ref.lines || text.words != ref.words || text.width != ref.width)
+		{
+			printf("valid: %lu lines %lu words %g wide instead of %lu lines %lu words %g wide\n",
+				(unsigned long)text.lines, (unsigned long)text.words, text.width,
+				(unsigned long)ref.lines, (unsigned long)ref.words, ref.width);
+			failures++;
+		}
+
+		static const u32 flags[] = { 0, C2D_AlignRight, C2D_AlignCenter, C2D_AlignJustified, C2D_WordWrap, C2D_WordWrap|C2D_AlignJustified };
+		static C2Di_Vertex vertices[4*MAX_GLYPHS];
+		C2Di_Context* ctx = C2Di_GetContext();
+		size_t i;
+		for (i = 0; i < sizeof(flags)/sizeof(flags[0]); i ++)
+		{
+			const C2D_Text* texts[] = { &text, &ref };
+			size_t numVertices[2], j;
+			for (j = 0; j < 2; j ++)
+			{
+				C2D_Prepare();
+				ctx->vtxBufPos = ctx->idxBufPos = ctx->idxBufLastPos = 0;
+				C2D_DrawText(texts[j], flags[i], 10.0f, 20.0f, 0.5f, 1.0f, 1.0f, 30.0f);
+				C2D_Flush();
+				numVertices[j] = ctx->vtxBufPos;
+				if (j == 0)
+					memcpy(vertices, ctx->vtxBuf, ctx->vtxBufPos*sizeof(C2Di_Vertex));
+			}
+			if (numVertices[0] != numVertices[1] || memcmp(vertices, ctx->vtxBuf, numVertices[0]*sizeof(C2Di_Vertex)) != 0)
+			{
+				printf("valid: drawn differently with flags %#lx\n", (unsigned long)flags[i]);
+				failures++;
+			}
+		}
+		C2D_TextBufDelete(buf);
+	}
+	C2D_TextBufDelete(refBuf);
+
+	bad = table;
+	bad.glyphs[2].lineNo = bad.string.lines;
+	failures += checkRejected("line out of range", &bad, size);
+
+	bad = table;
+	bad.string.lines = 0;
+	failures += checkRejected("no lines", &bad, size);
+
+	bad = table;
+	bad.string.words++;
+	failures += checkRejected("too many words", &bad, size);
+
+	bad = table;
+	bad.string.words--;
+	failures += checkRejected("too few words", &bad, size);
+
+	bad = table;
+	bad.glyphs[2].wordNo = 2; // 'c' skips a word
+	bad.glyphs[3].wordNo = 2;
+	failures += checkRejected("word gap", &bad, size);
+
+	bad = table;
+	bad.glyphs[0].wordNo = 1;
+	failures += checkRejected("first word", &bad, size);
+
+	bad = table;
+	bad.glyphs[bad.string.numGlyphs-1].lineNo = 0; // Back to the first line
+	failures += checkRejected("line order", &bad, size);
+
+	C2D_Fini();
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+// Parses random UTF-8 strings stored at the very end of their allocation, so that reading past the
+// terminator is caught by the sanitizers, and checks the result against a character by character decode.
+#include <citro2d.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+
+static const char* const s_pieces[] =
+{
+	"a", "b", "Z", "0", "~", " ", " ", "\n", "{",
+	"\xC3\xA9",         // U+00E9
+	"\xE4\xB8\x80",     // U+4E00
+	"\xE2\x80\xA6",     // U+2026, in the scan CMAP
+	"\xF0\x9F\x98\x80", // U+1F600, not in the font
+	"\xFF",             // Invalid
+	"\xE4\xB8",         // Truncated
+};
+
+static u32 s_seed = 12345;
+
+static u32 nextRandom(void)
+{
+	s_seed = s_seed*1103515245 + 12345;
+	return s_seed >> 16;
+}
+
+static float charWidth(u32 code)
+{
+	return fontGetCharWidthInfo(NULL, fontGlyphIndexFromCodePoint(NULL, code))->charWidth;
+}
+
+static bool hasGlyph(u32 code)
+{
+	return fontGetCharWidthInfo(NULL, fontGlyphIndexFromCodePoint(NULL, code))->glyphWidth > 0;
+}
+
+static int checkString(C2D_TextBuf buf, const char* str, size_t len)
+{
+	char* copy = (char*)malloc(len+1);
+	memcpy(copy, str, len+1);
+
+	size_t glyphs = 0;
+	u32 lines = 1;
+	float width = 0.0f, lineWidth = 0.0f;
+	const uint8_t* p = (const uint8_t*)str;
+	while (*p)
+	{
+		u32 code;
+		ssize_t units = decode_utf8(&code, p);
+		if (units < 0)
+		{
+			code = 0xFFFD;
+			units = 1;
+		}
+		p += units;
+
+		if (code == '\n')
+		{
+			lines++;
+			lineWidth = 0.0f;
+			continue;
+		}
+		glyphs += hasGlyph(code);
+		lineWidth += charWidth(code);
+		if (lineWidth > width)
+			width = lineWidth;
+	}
+	width *= 30.0f / fontGetGlyphInfo(NULL)->cellHeight;
+
+	C2D_Text text;
+	C2D_TextBufClear(buf);
+	const char* end = C2D_TextParse(&text, buf, copy);
+	int ret = 0;
+	if (end != copy + len || text.end - text.begin != glyphs || text.lines != lines || text.width != width)
+	{
+		printf("Mismatch for \"%s\" (%zu bytes): %zu/%zu glyphs, %lu/%lu lines, %g/%g width\n", str, len,
+			text.end - text.begin, glyphs, (unsigned long)text.lines, (unsigned long)lines, text.width, width);
+		ret = 1;
+	}
+	free(copy);
+	return ret;
+}
+
+int main(void)
+{
+	C2D_TextBuf buf = C2D_TextBufNew(1024);
+	char str[256];
+	int failures = 0, i;
+	for (i = 0; i < 20000 && failures < 10; i ++)
+	{
+		size_t len = 0, target = nextRandom() % 64;
+		while (len < target)
+		{
+			const char* piece = s_pieces[nextRandom() % (sizeof(s_pieces)/sizeof(s_pieces[0]))];
+			size_t pieceLen = strlen(piece);
+			memcpy(str + len, piece, pieceLen);
+			len += pieceLen;
+		}
+		str[len] = 0;
+		failures += checkString(buf, str, len);
+	}
+	C2D_TextBufDelete(buf);
+
+	if (failures)
+		return 1;
+	printf("%d strings parsed\n", i);
+	return 0;
+}
@@ -0,0 +1,252 @@
+// Minimal BCFNT reader for the host tools, which can't use libctru's font structures since those contain
+// 32-bit pointers. Offsets are the same ones fontFixPointers turns into pointers: relative to the start of
+// the file, pointing past the header of each section.
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+	uint8_t* data;
+	size_t size;
+
+	uint32_t finf, tglp, cwdh, cmap; // Section offsets
+	uint16_t alterCharIndex;
+	uint8_t cellWidth, cellHeight;
+	uint32_t sheetSize;
+	uint16_t nSheets, nRows, nLines;
+	uint32_t sheetData;
+} Bcfnt;
+
+static inline uint16_t bcfntRead16(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t bcfntRead32(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void bcfntWrite16(uint8_t* p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static inline void bcfntWrite32(uint8_t* p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+// Bits per texel of a glyph sheet format, 0 for ETC1 which is compressed in blocks
+static inline uint32_t bcfntFormatBits(uint16_t fmt)
+{
+	switch (fmt)
+	{
+		case 0x0: return 32; // RGBA8
+		case 0x1: return 24; // RGB8
+		case 0x2: case 0x3: case 0x4: case 0x5: case 0x6: return 16; // RGBA5551, RGB565, RGBA4, LA8, HILO8
+		case 0x7: case 0x8: case 0x9: return 8; // L8, A8, LA4
+		case 0xA: case 0xB: return 4; // L4, A4
+		default: return 0;
+	}
+}
+
+// Textures are made of 8x8 tiles with their texels in Z-order, rows going upwards
+static inline uint32_t bcfntTexelIndex(uint32_t x, uint32_t y, uint32_t width)
+{
+	uint32_t morton = (x&1) | ((y&1)<<1) | ((x&2)<<1) | ((y&2)<<2) | ((x&4)<<2) | ((y&4)<<3);
+	return (((y>>3)*(width>>3) + (x>>3)) << 6) | morton;
+}
+
+// Region fonts from the system archive are LZ11 compressed
+static inline uint8_t* bcfntDecompressLZ11(const uint8_t* in, size_t inSize, size_t* outSize)
+{
+	if (inSize < 4 || in[0] != 0x11)
+		return NULL;
+	size_t size = bcfntRead32(in) >> 8, pos = 0, i = 4;
+	if (!size)
+	{
+		if (inSize < 8)
+			return NULL;
+		size = bcfntRead32(in + 4);
+		i = 8;
+	}
+	uint8_t* out = (uint8_t*)malloc(size);
+	if (!out)
+		return NULL;
+
+	uint8_t flags = 0, mask = 0;
+	while (pos < size)
+	{
+		if (!mask)
+		{
+			if (i >= inSize)
+				goto _fail;
+			flags = in[i++];
+			mask = 0x80;
+		}
+		bool ref = flags & mask;
+		mask >>= 1;
+
+		if (!ref)
+		{
+			if (i >= inSize)
+				goto _fail;
+			out[pos++] = in[i++];
+			continue;
+		}
+
+		if (i + 2 > inSize)
+			goto _fail;
+		size_t len, disp;
+		switch (in[i] >> 4)
+		{
+			case 0:
+				if (i + 3 > inSize)
+					goto _fail;
+				len  = (((in[i] & 0xF) << 4) | (in[i+1] >> 4)) + 0x11;
+				disp = ((in[i+1] & 0xF) << 8) | in[i+2];
+				i += 3;
+				break;
+			case 1:
+				if (i + 4 > inSize)
+					goto _fail;
+				len  = (((in[i] & 0xF) << 12) | (in[i+1] << 4) | (in[i+2] >> 4)) + 0x111;
+				disp = ((in[i+2] & 0xF) << 8) | in[i+3];
+				i += 4;
+				break;
+			default:
+				len  = (in[i] >> 4) + 1;
+				disp = ((in[i] & 0xF) << 8) | in[i+1];
+				i += 2;
+				break;
+		}
+		disp++;
+		if (disp > pos || len > size - pos)
+			goto _fail;
+		while (len--)
+		{
+			out[pos] = out[pos - disp];
+			pos++;
+		}
+	}
+	*outSize = size;
+	return out;
+
+_fail:
+	free(out);
+	return NULL;
+}
+
+static inline bool bcfntLoad(Bcfnt* font, const char* path)
+{
+	memset(font, 0, sizeof(Bcfnt));
+	FILE* f = fopen(path, "rb");
+	if (!f)
+		return false;
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	rewind(f);
+	uint8_t* data = size > 0 ? (uint8_t*)malloc(size) : NULL;
+	bool ok = data && fread(data, 1, size, f) == (size_t)size;
+	fclose(f);
+	if (!ok)
+	{
+		free(data);
+		return false;
+	}
+
+	font->data = data;
+	font->size = size;
+	if (size >= 4 && data[0] == 0x11)
+	{
+		font->data = bcfntDecompressLZ11(data, size, &font->size);
+		free(data);
+		if (!font->data)
+			return false;
+	}
+
+	data = font->data;
+	if (font->size < 0x14 || memcmp(data, "CFNT", 4) != 0)
+		return false;
+	font->finf = bcfntRead16(data + 6);
+	if (font->finf + 0x20 > font->size)
+		return false;
+	font->alterCharIndex = bcfntRead16(data + font->finf + 0xA);
+	font->tglp = bcfntRead32(data + font->finf + 0x10);
+	font->cwdh = bcfntRead32(data + font->finf + 0x14);
+	font->cmap = bcfntRead32(data + font->finf + 0x18);
+	if (font->tglp + 0x18 > font->size)
+		return false;
+
+	const uint8_t* tglp = data + font->tglp;
+	font->cellWidth  = tglp[0];
+	font->cellHeight = tglp[1];
+	font->sheetSize  = bcfntRead32(tglp + 4);
+	font->nSheets    = bcfntRead16(tglp + 8);
+	font->nRows      = bcfntRead16(tglp + 0xC);
+	font->nLines     = bcfntRead16(tglp + 0xE);
+	font->sheetData  = bcfntRead32(tglp + 0x14);
+	return font->sheetData <= font->size && (uint64_t)font->sheetSize*font->nSheets <= font->size - font->sheetData;
+}
+
+static inline void bcfntFree(Bcfnt* font)
+{
+	free(font->data);
+	font->data = NULL;
+}
+
+// Same as libctru's fontGlyphIndexFromCodePoint
+static inline int bcfntGlyphIndex(const Bcfnt* font, uint32_t code)
+{
+	if (code >= 0x10000)
+		return font->alterCharIndex;
+
+	uint32_t cmap;
+	for (cmap = font->cmap; cmap && cmap + 0xC <= font->size; cmap = bcfntRead32(font->data + cmap + 8))
+	{
+		const uint8_t* p = font->data + cmap;
+		uint16_t codeBegin = bcfntRead16(p), codeEnd = bcfntRead16(p + 2);
+		if (code < codeBegin || code > codeEnd)
+			continue;
+
+		switch (bcfntRead16(p + 4))
+		{
+			case 0: // Direct
+				return bcfntRead16(p + 0xC) + (code - codeBegin);
+			case 1: // Table
+				return bcfntRead16(p + 0xC + 2*(code - codeBegin));
+			default: // Scan
+			{
+				uint16_t i, n = bcfntRead16(p + 0xC);
+				for (i = 0; i < n; i ++)
+					if (bcfntRead16(p + 0xE + 4*i) == code)
+						return bcfntRead16(p + 0x10 + 4*i);
+				break;
+			}
+		}
+	}
+	return font->alterCharIndex;
+}
+
+// Same as libctru's fontGetCharWidthInfo, returns the left, glyphWidth, charWidth triple
+static inline const uint8_t* bcfntCharWidth(const Bcfnt* font, int glyphIndex)
+{
+	uint32_t cwdh;
+	for (cwdh = font->cwdh; cwdh && cwdh + 8 <= font->size; cwdh = bcfntRead32(font->data + cwdh + 4))
+	{
+		const uint8_t* p = font->data + cwdh;
+		if (glyphIndex < bcfntRead16(p) || glyphIndex > bcfntRead16(p + 2))
+			continue;
+		return p + 8 + 3*(glyphIndex - bcfntRead16(p));
+	}
+	return font->data + font->finf + 0xC; // Default width
+}
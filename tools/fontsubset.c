@@ -0,0 +1,290 @@
+// fontsubset: strips a BCFNT down to the glyphs of a given character set, for use with C2D_FontLoad.
+//
+// Usage: fontsubset <input.bcfnt> <charset.txt> <output.bcfnt>
+//
+// Every character of the UTF-8 charset file is kept (line breaks excluded), along with the replacement glyph
+// of the font. The kept glyphs are packed into as few glyph sheets as possible, keeping the sheet format and
+// cell layout of the input font, and the character maps and widths are rewritten to match.
+//
+// Build with a host compiler, e.g.: cc -O2 -o fontsubset fontsubset.c
+#include "bcfnt.h"
+
+#define MIN_DIRECT_RUN 4 // Shorter runs of consecutive codes go into the scan map
+
+typedef struct
+{
+	uint16_t code;
+	uint16_t oldIndex, newIndex;
+} Mapping;
+
+static bool s_keep[0x10000];
+
+static void copyTexel(uint8_t* dst, uint32_t dstIndex, const uint8_t* src, uint32_t srcIndex, uint32_t bits)
+{
+	if (bits == 4)
+	{
+		uint32_t shift = (dstIndex & 1)*4;
+		uint8_t texel = (src[srcIndex>>1] >> ((srcIndex & 1)*4)) & 0xF;
+		dst[dstIndex>>1] = (dst[dstIndex>>1] & ~(0xF << shift)) | (texel << shift);
+	} else
+		memcpy(&dst[dstIndex*bits/8], &src[srcIndex*bits/8], bits/8);
+}
+
+// Copies the texels of a glyph, which are where fontCalcGlyphPos expects them to be
+static void copyGlyph(const Bcfnt* font, uint8_t* dstSheets, uint32_t newIndex, uint32_t oldIndex, uint32_t bits)
+{
+	const uint8_t* tglp = font->data + font->tglp;
+	uint32_t width  = bcfntRead16(tglp + 0x10);
+	uint32_t height = bcfntRead16(tglp + 0x12);
+	uint32_t perSheet = font->nRows*font->nLines;
+	uint32_t cellW = font->cellWidth + 1, cellH = font->cellHeight + 1;
+	uint32_t srcLine = oldIndex % perSheet / font->nRows, dstLine = newIndex % perSheet / font->nRows;
+	if ((srcLine+1)*cellH + 1 > height || (dstLine+1)*cellH + 1 > height)
+		return;
+
+	const uint8_t* src = font->data + font->sheetData + (oldIndex / perSheet)*font->sheetSize;
+	uint8_t* dst = dstSheets + (newIndex / perSheet)*font->sheetSize;
+	uint32_t srcX = (oldIndex % perSheet % font->nRows)*cellW + 1, srcY = height - (srcLine+1)*cellH - 1;
+	uint32_t dstX = (newIndex % perSheet % font->nRows)*cellW + 1, dstY = height - (dstLine+1)*cellH - 1;
+
+	uint32_t x, y;
+	for (y = 0; y < font->cellHeight; y ++)
+		for (x = 0; x < font->cellWidth && srcX + x < width && dstX + x < width; x ++)
+			copyTexel(dst, bcfntTexelIndex(dstX + x, dstY + y, width), src, bcfntTexelIndex(srcX + x, srcY + y, width), bits);
+}
+
+// Returns the end of the run of consecutive codes mapped to consecutive glyphs that starts at the given mapping
+static uint32_t runEnd(const Mapping* mappings, uint32_t i, uint32_t numMappings)
+{
+	uint32_t j = i + 1;
+	while (j < numMappings && mappings[j].code == mappings[j-1].code+1 && mappings[j].newIndex == mappings[j-1].newIndex+1)
+		j++;
+	return j;
+}
+
+static int compareMappings(const void* a, const void* b)
+{
+	return (int)((const Mapping*)a)->code - (int)((const Mapping*)b)->code;
+}
+
+static void readCharset(const char* path)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f)
+	{
+		fprintf(stderr, "fontsubset: can't open %s\n", path);
+		exit(1);
+	}
+
+	// Decode UTF-8 leniently, invalid bytes are skipped
+	int c;
+	while ((c = fgetc(f)) != EOF)
+	{
+		uint32_t code = c, len = 0, i;
+		if (c >= 0xF0)
+		{
+			code = c & 0x07;
+			len = 3;
+		} else if (c >= 0xE0)
+		{
+			code = c & 0x0F;
+			len = 2;
+		} else if (c >= 0xC0)
+		{
+			code = c & 0x1F;
+			len = 1;
+		} else if (c >= 0x80)
+			continue;
+		for (i = 0; i < len && (c = fgetc(f)) != EOF && (c & 0xC0) == 0x80; i ++)
+			code = (code << 6) | (c & 0x3F);
+		if (i < len)
+		{
+			if (c != EOF)
+				ungetc(c, f);
+			continue;
+		}
+		if (code < 0x10000 && code != '\n' && code != '\r')
+			s_keep[code] = true;
+	}
+	fclose(f);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 4)
+	{
+		fprintf(stderr, "Usage: %s <input.bcfnt> <charset.txt> <output.bcfnt>\n", argv[0]);
+		return 1;
+	}
+
+	Bcfnt font;
+	if (!bcfntLoad(&font, argv[1]))
+	{
+		fprintf(stderr, "fontsubset: can't load font %s\n", argv[1]);
+		return 1;
+	}
+	const uint8_t* tglp = font.data + font.tglp;
+	uint32_t bits = bcfntFormatBits(bcfntRead16(tglp + 0xA));
+	if (!bits)
+	{
+		fprintf(stderr, "fontsubset: unsupported sheet format\n");
+		return 1;
+	}
+	readCharset(argv[2]);
+
+	// The replacement glyph comes first, then the glyphs in order of their first code
+	uint32_t numGlyphs = 0, numOld = font.nSheets*font.nRows*font.nLines;
+	uint16_t* oldToNew = (uint16_t*)malloc(numOld*sizeof(uint16_t));
+	uint16_t* newToOld = (uint16_t*)malloc(numOld*sizeof(uint16_t));
+	Mapping* mappings = (Mapping*)malloc(0x10000*sizeof(Mapping));
+	if (!oldToNew || !newToOld || !mappings || font.alterCharIndex >= numOld)
+	{
+		fprintf(stderr, "fontsubset: invalid font or out of memory\n");
+		return 1;
+	}
+	memset(oldToNew, 0xFF, numOld*sizeof(uint16_t));
+	oldToNew[font.alterCharIndex] = numGlyphs;
+	newToOld[numGlyphs++] = font.alterCharIndex;
+
+	uint32_t code, numMappings = 0;
+	for (code = 0; code < 0x10000; code ++)
+	{
+		if (!s_keep[code])
+			continue;
+		int oldIndex = bcfntGlyphIndex(&font, code);
+		if (oldIndex < 0 || (uint32_t)oldIndex >= numOld || (oldIndex == font.alterCharIndex && code != 0xFFFD))
+			continue; // Not in the font, falls back to the replacement glyph anyway
+		if (oldToNew[oldIndex] == 0xFFFF)
+		{
+			oldToNew[oldIndex] = numGlyphs;
+			newToOld[numGlyphs++] = oldIndex;
+		}
+		mappings[numMappings].code     = code;
+		mappings[numMappings].oldIndex = oldIndex;
+		mappings[numMappings].newIndex = oldToNew[oldIndex];
+		numMappings++;
+	}
+	if (!numMappings)
+	{
+		fprintf(stderr, "fontsubset: no character of the set is in the font\n");
+		return 1;
+	}
+	qsort(mappings, numMappings, sizeof(Mapping), compareMappings);
+
+	// Split the mappings into direct maps for runs of consecutive codes and glyphs, and one scan map for the rest
+	uint32_t numDirect = 0, numScan = 0, i, j;
+	for (i = 0; i < numMappings; i = j)
+	{
+		j = runEnd(mappings, i, numMappings);
+		if (j - i >= MIN_DIRECT_RUN)
+			numDirect++;
+		else
+			numScan += j - i;
+	}
+
+	uint32_t perSheet = font.nRows*font.nLines;
+	uint32_t nSheets  = (numGlyphs + perSheet - 1) / perSheet;
+	uint32_t cwdhSize = (8 + 8 + 3*numGlyphs + 3) &~ 3;
+	uint32_t scanSize = numScan ? (8 + 0xC + 2 + 4*numScan + 3) &~ 3 : 0;
+
+	// Layout: header, FINF, TGLP (sheets aligned to 0x80), CWDH, CMAPs
+	uint32_t finfPos  = 0x14;
+	uint32_t tglpPos  = finfPos + 0x20;
+	uint32_t sheetPos = 0x80;
+	uint32_t cwdhPos  = sheetPos + nSheets*font.sheetSize;
+	uint32_t cmapPos  = cwdhPos + cwdhSize;
+	uint32_t fileSize = cmapPos + numDirect*(8 + 0xC + 4) + scanSize;
+
+	uint8_t* out = (uint8_t*)calloc(1, fileSize);
+	if (!out)
+	{
+		fprintf(stderr, "fontsubset: out of memory\n");
+		return 1;
+	}
+
+	memcpy(out, "CFNT", 4);
+	bcfntWrite16(out + 4, 0xFEFF);
+	bcfntWrite16(out + 6, 0x14);
+	memcpy(out + 8, font.data + 8, 4); // Version
+	bcfntWrite32(out + 0xC, fileSize);
+	bcfntWrite32(out + 0x10, 3 + numDirect + (numScan ? 1 : 0));
+
+	uint8_t* finf = out + finfPos;
+	memcpy(finf, font.data + font.finf, 0x20); // Font metrics are kept as they are
+	bcfntWrite32(finf + 4, 0x20);
+	bcfntWrite16(finf + 0xA, 0); // The replacement glyph is now the first one
+	bcfntWrite32(finf + 0x10, tglpPos + 8);
+	bcfntWrite32(finf + 0x14, cwdhPos + 8);
+	bcfntWrite32(finf + 0x18, cmapPos + 8);
+
+	uint8_t* newTglp = out + tglpPos;
+	memcpy(newTglp, "TGLP", 4);
+	bcfntWrite32(newTglp + 4, cwdhPos - tglpPos);
+	memcpy(newTglp + 8, tglp, 0x18);
+	bcfntWrite16(newTglp + 8 + 8, nSheets);
+	bcfntWrite32(newTglp + 8 + 0x14, sheetPos);
+	for (i = 0; i < numGlyphs; i ++)
+		copyGlyph(&font, out + sheetPos, i, newToOld[i], bits);
+
+	uint8_t* cwdh = out + cwdhPos;
+	memcpy(cwdh, "CWDH", 4);
+	bcfntWrite32(cwdh + 4, cwdhSize);
+	bcfntWrite16(cwdh + 8, 0);
+	bcfntWrite16(cwdh + 10, numGlyphs - 1);
+	bcfntWrite32(cwdh + 12, 0);
+	for (i = 0; i < numGlyphs; i ++)
+		memcpy(cwdh + 16 + 3*i, bcfntCharWidth(&font, newToOld[i]), 3);
+
+	uint32_t pos = cmapPos, numScanned = 0;
+	uint8_t* scan = scanSize ? out + fileSize - scanSize : NULL;
+	for (i = 0; i < numMappings; i = j)
+	{
+		j = runEnd(mappings, i, numMappings);
+		if (j - i < MIN_DIRECT_RUN)
+		{
+			for (; i < j; i ++, numScanned ++)
+			{
+				bcfntWrite16(scan + 8 + 0xE + 4*numScanned, mappings[i].code);
+				bcfntWrite16(scan + 8 + 0x10 + 4*numScanned, mappings[i].newIndex);
+			}
+			continue;
+		}
+
+		uint8_t* cmap = out + pos;
+		pos += 8 + 0xC + 4;
+		memcpy(cmap, "CMAP", 4);
+		bcfntWrite32(cmap + 4, 8 + 0xC + 4);
+		bcfntWrite16(cmap + 8, mappings[i].code);
+		bcfntWrite16(cmap + 10, mappings[j-1].code);
+		bcfntWrite16(cmap + 12, 0); // Direct
+		bcfntWrite32(cmap + 16, pos < fileSize ? pos + 8 : 0);
+		bcfntWrite16(cmap + 20, mappings[i].newIndex);
+	}
+	if (scan)
+	{
+		memcpy(scan, "CMAP", 4);
+		bcfntWrite32(scan + 4, scanSize);
+		bcfntWrite16(scan + 8, 0);
+		bcfntWrite16(scan + 10, 0xFFFF);
+		bcfntWrite16(scan + 12, 2); // Scan
+		bcfntWrite32(scan + 16, 0);
+		bcfntWrite16(scan + 20, numScan);
+	}
+	FILE* f = fopen(argv[3], "wb");
+	bool ok = f && fwrite(out, 1, fileSize, f) == fileSize;
+	if (f)
+		ok = fclose(f) == 0 && ok;
+	if (!ok)
+	{
+		fprintf(stderr, "fontsubset: can't write %s\n", argv[3]);
+		return 1;
+	}
+	printf("%u glyphs in %u sheets (was %u sheets), %u bytes\n", numGlyphs, nSheets, font.nSheets, fileSize);
+
+	free(out);
+	free(mappings);
+	free(newToOld);
+	free(oldToNew);
+	bcfntFree(&font);
+	return 0;
+}
@@ -0,0 +1,165 @@
+// sdffont: converts the glyph sheets of a BCFNT into signed distance fields, for use with C2D_FontSetDistanceField.
+//
+// Usage: sdffont <input.bcfnt> <output.bcfnt> [spread]
+//
+// Each glyph is replaced by the distance of its texels to the outline of the glyph, stored in A8 sheets with the
+// same layout as the input: 128 is on the outline, and 0 and 255 are spread texels (4 by default) outside and
+// inside of it. Citro2D draws the outline with an edge 1/32 of the field wide, which is a quarter of a texel with
+// the default spread, so that it stays sharp when magnified up to 4x; a larger spread gives softer edges.
+// Input sheets can be in any alpha or luminance format, everything else is kept as it is.
+//
+// Build with a host compiler, e.g.: cc -O2 -o sdffont sdffont.c -lm
+#include <math.h>
+#include "bcfnt.h"
+
+#define DEFAULT_SPREAD 4
+
+// Coverage of a texel: its alpha, or its luminance for formats without alpha
+static float readCoverage(const uint8_t* sheet, uint32_t index, uint16_t fmt)
+{
+	switch (fmt)
+	{
+		case 0x5: return sheet[2*index] / 255.0f;                      // LA8
+		case 0x7: case 0x8: return sheet[index] / 255.0f;              // L8, A8
+		case 0x9: return (sheet[index] & 0xF) / 15.0f;                 // LA4
+		default: return ((sheet[index>>1] >> ((index&1)*4)) & 0xF) / 15.0f; // L4, A4
+	}
+}
+
+// Signed distance of a texel to the outline of its glyph, in texels: positive inside, negative outside
+static float glyphDistance(const float* coverage, int w, int h, int x, int y, int spread)
+{
+	float c = coverage[y*w + x];
+	if (c > 0.0f && c < 1.0f)
+		return c - 0.5f; // On the antialiased outline already
+
+	// Nearest texel on the other side of the outline, anything outside of the cell being outside of the glyph
+	bool inside = c >= 0.5f;
+	float best = spread + 0.5f;
+	int dx, dy;
+	for (dy = -spread; dy <= spread; dy ++)
+		for (dx = -spread; dx <= spread; dx ++)
+		{
+			int sx = x + dx, sy = y + dy;
+			float sc = sx >= 0 && sx < w && sy >= 0 && sy < h ? coverage[sy*w + sx] : 0.0f;
+			if ((sc >= 0.5f) == inside)
+				continue;
+			// The outline crosses the other texel where its coverage is 0.5
+			float d = sqrtf((float)(dx*dx + dy*dy)) - fabsf(sc - 0.5f);
+			if (d < best)
+				best = d;
+		}
+	return inside ? best - 0.5f : 0.5f - best;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 3 && argc != 4)
+	{
+		fprintf(stderr, "Usage: %s <input.bcfnt> <output.bcfnt> [spread]\n", argv[0]);
+		return 1;
+	}
+	int spread = argc == 4 ? atoi(argv[3]) : DEFAULT_SPREAD;
+	if (spread < 1 || spread > 64)
+	{
+		fprintf(stderr, "sdffont: spread must be between 1 and 64 texels\n");
+		return 1;
+	}
+
+	Bcfnt font;
+	if (!bcfntLoad(&font, argv[1]))
+	{
+		fprintf(stderr, "sdffont: can't load font %s\n", argv[1]);
+		return 1;
+	}
+	const uint8_t* tglp = font.data + font.tglp;
+	uint16_t fmt = bcfntRead16(tglp + 0xA);
+	if (fmt != 0x5 && (fmt < 0x7 || fmt > 0xB))
+	{
+		fprintf(stderr, "sdffont: the sheet format has no alpha or luminance channel\n");
+		return 1;
+	}
+
+	// The sheets grow to 8 bits per texel, sections stored after them move along
+	uint32_t width  = bcfntRead16(tglp + 0x10);
+	uint32_t height = bcfntRead16(tglp + 0x12);
+	uint32_t newSheetSize = width*height;
+	uint32_t sheetsEnd = font.sheetData + font.nSheets*font.sheetSize;
+	uint32_t delta = font.nSheets*(newSheetSize - font.sheetSize);
+	if (newSheetSize < font.sheetSize || sheetsEnd > font.size)
+	{
+		fprintf(stderr, "sdffont: invalid glyph sheets\n");
+		return 1;
+	}
+	size_t newSize = font.size + delta;
+	uint8_t* out = (uint8_t*)calloc(1, newSize);
+	float* coverage = (float*)malloc(font.cellWidth*font.cellHeight*sizeof(float));
+	if (!out || !coverage)
+	{
+		fprintf(stderr, "sdffont: out of memory\n");
+		return 1;
+	}
+	memcpy(out, font.data, font.sheetData);
+	memcpy(out + sheetsEnd + delta, font.data + sheetsEnd, font.size - sheetsEnd);
+
+	#define MOVED(offset) ((offset) >= sheetsEnd ? (offset) + delta : (offset))
+	uint8_t* finf = out + font.finf;
+	uint32_t newTglp = MOVED(font.tglp);
+	bcfntWrite32(out + 0xC, newSize);
+	bcfntWrite32(finf + 0x10, newTglp);
+	bcfntWrite32(finf + 0x14, MOVED(font.cwdh));
+	bcfntWrite32(finf + 0x18, MOVED(font.cmap));
+	bcfntWrite32(out + newTglp + 4, newSheetSize);
+	bcfntWrite16(out + newTglp + 0xA, 0x8); // A8
+	bcfntWrite32(out + newTglp - 4, bcfntRead32(out + newTglp - 4) + delta); // TGLP section size
+
+	uint32_t offset;
+	for (offset = font.cwdh; offset && offset + 8 <= font.size; offset = bcfntRead32(font.data + offset + 4))
+		bcfntWrite32(out + MOVED(offset) + 4, MOVED(bcfntRead32(font.data + offset + 4)));
+	for (offset = font.cmap; offset && offset + 0xC <= font.size; offset = bcfntRead32(font.data + offset + 8))
+		bcfntWrite32(out + MOVED(offset) + 8, MOVED(bcfntRead32(font.data + offset + 8)));
+	#undef MOVED
+
+	// Glyphs are where fontCalcGlyphPos expects them to be, the separators between them are left empty
+	uint32_t perSheet = font.nRows*font.nLines, glyph;
+	uint32_t cellW = font.cellWidth + 1, cellH = font.cellHeight + 1;
+	for (glyph = 0; glyph < font.nSheets*perSheet; glyph ++)
+	{
+		uint32_t line = glyph % perSheet / font.nRows;
+		if ((line+1)*cellH + 1 > height)
+			continue;
+		const uint8_t* src = font.data + font.sheetData + (glyph / perSheet)*font.sheetSize;
+		uint8_t* dst = out + font.sheetData + (glyph / perSheet)*newSheetSize;
+		uint32_t glyphX = (glyph % perSheet % font.nRows)*cellW + 1, glyphY = height - (line+1)*cellH - 1;
+		uint32_t w = font.cellWidth, h = font.cellHeight, x, y;
+		if (glyphX + w > width)
+			w = width - glyphX;
+
+		for (y = 0; y < h; y ++)
+			for (x = 0; x < w; x ++)
+				coverage[y*w + x] = readCoverage(src, bcfntTexelIndex(glyphX + x, glyphY + y, width), fmt);
+		for (y = 0; y < h; y ++)
+			for (x = 0; x < w; x ++)
+			{
+				float d = 0.5f + glyphDistance(coverage, w, h, x, y, spread) / (2*spread);
+				d = d < 0.0f ? 0.0f : d > 1.0f ? 1.0f : d;
+				dst[bcfntTexelIndex(glyphX + x, glyphY + y, width)] = (uint8_t)lroundf(d*255.0f);
+			}
+	}
+
+	FILE* f = fopen(argv[2], "wb");
+	bool ok = f && fwrite(out, 1, newSize, f) == newSize;
+	if (f)
+		ok = fclose(f) == 0 && ok;
+	if (!ok)
+	{
+		fprintf(stderr, "sdffont: can't write %s\n", argv[2]);
+		return 1;
+	}
+	printf("%u sheets converted, %zu bytes\n", font.nSheets, newSize);
+
+	free(coverage);
+	free(out);
+	bcfntFree(&font);
+	return 0;
+}
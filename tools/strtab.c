@@ -0,0 +1,254 @@
+// strtab: pre-parses a table of strings for C2D_TextTableLoad, so that they don't go through the text parser at runtime.
+//
+// Usage: strtab <font.bcfnt> <strings.txt> <output.bin>
+//
+// The strings file contains one UTF-8 string per line. Within a string, \n stands for a line break and \\ for a
+// backslash. The font can be any BCFNT file (LZ11 compressed or not); for the system font, use a dump of the
+// font of the console region the table is meant for. The output has to be loaded with the same font.
+//
+// Build with a host compiler, e.g.: cc -O2 -o strtab strtab.c
+#include "bcfnt.h"
+
+#define TABLE_VERSION 1
+
+typedef struct
+{
+	float xPos;
+	uint16_t sheet, sheetGlyph, lineNo, wordNo, width;
+} Glyph;
+
+typedef struct
+{
+	uint32_t firstGlyph, numGlyphs;
+	float width;
+	uint32_t lines, words;
+} String;
+
+static Glyph* s_glyphs;
+static size_t s_numGlyphs, s_glyphCap;
+static String* s_strings;
+static size_t s_numStrings, s_stringCap;
+
+static void* grow(void* array, size_t* cap, size_t count, size_t elemSize)
+{
+	if (count < *cap)
+		return array;
+	*cap = *cap ? 2 * *cap : 256;
+	array = realloc(array, *cap * elemSize);
+	if (!array)
+	{
+		fprintf(stderr, "strtab: out of memory\n");
+		exit(1);
+	}
+	return array;
+}
+
+// Same as libctru's decode_utf8, returns -1 for invalid sequences
+static int decodeUtf8(uint32_t* out, const uint8_t* in)
+{
+	uint8_t c = in[0];
+	if (c < 0x80)
+	{
+		*out = c;
+		return 1;
+	}
+	if (c < 0xC2)
+		return -1;
+	if (c < 0xE0)
+	{
+		if ((in[1] & 0xC0) != 0x80)
+			return -1;
+		*out = ((c & 0x1F) << 6) | (in[1] & 0x3F);
+		return 2;
+	}
+	if (c < 0xF0)
+	{
+		if ((in[1] & 0xC0) != 0x80 || (c == 0xE0 && in[1] < 0xA0) || (in[2] & 0xC0) != 0x80)
+			return -1;
+		*out = ((c & 0x0F) << 12) | ((in[1] & 0x3F) << 6) | (in[2] & 0x3F);
+		return 3;
+	}
+	if (c < 0xF5)
+	{
+		if ((in[1] & 0xC0) != 0x80 || (c == 0xF0 && in[1] < 0x90) || (c == 0xF4 && in[1] >= 0x90)
+			|| (in[2] & 0xC0) != 0x80 || (in[3] & 0xC0) != 0x80)
+			return -1;
+		*out = ((c & 0x07) << 18) | ((in[1] & 0x3F) << 12) | ((in[2] & 0x3F) << 6) | (in[3] & 0x3F);
+		return 4;
+	}
+	return -1;
+}
+
+// Produces the same glyphs and metrics as C2D_TextFontParse
+static void parseString(const Bcfnt* font, const uint8_t* p)
+{
+	s_strings = (String*)grow(s_strings, &s_stringCap, s_numStrings, sizeof(String));
+	String* str = &s_strings[s_numStrings++];
+	str->firstGlyph = s_numGlyphs;
+	str->width = 0.0f;
+	str->lines = 0;
+	str->words = 0;
+
+	uint32_t perSheet = font->nRows*font->nLines;
+	uint32_t lineNo = 0;
+	for (;;)
+	{
+		float width = 0.0f;
+		uint32_t wordNum = 0;
+		bool lastWasWhitespace = true;
+		while (*p && *p != '\n')
+		{
+			uint32_t code;
+			int len = decodeUtf8(&code, p);
+			if (len < 0)
+			{
+				code = 0xFFFD;
+				len = 1;
+			}
+			p += len;
+
+			int glyphIndex = bcfntGlyphIndex(font, code);
+			const uint8_t* cw = bcfntCharWidth(font, glyphIndex);
+			if (cw[1] > 0)
+			{
+				s_glyphs = (Glyph*)grow(s_glyphs, &s_glyphCap, s_numGlyphs, sizeof(Glyph));
+				Glyph* glyph = &s_glyphs[s_numGlyphs++];
+				glyph->xPos       = width + (float)(int8_t)cw[0];
+				glyph->sheet      = glyphIndex / perSheet;
+				glyph->sheetGlyph = glyphIndex % perSheet;
+				glyph->lineNo     = lineNo;
+				glyph->wordNo     = wordNum;
+				glyph->width      = cw[1];
+				lastWasWhitespace = false;
+			} else if (!lastWasWhitespace)
+			{
+				wordNum++;
+				lastWasWhitespace = true;
+			}
+			width += (float)cw[2];
+		}
+		if (!lastWasWhitespace)
+			wordNum++;
+
+		str->words += wordNum;
+		str->lines = lineNo + 1;
+		if (width > str->width)
+			str->width = width;
+
+		if (*p != '\n')
+			break;
+		p++;
+		lineNo++;
+	}
+	str->numGlyphs = s_numGlyphs - str->firstGlyph;
+}
+
+static void writeFloat(uint8_t* p, float v)
+{
+	uint32_t bits;
+	memcpy(&bits, &v, sizeof(bits));
+	bcfntWrite32(p, bits);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 4)
+	{
+		fprintf(stderr, "Usage: %s <font.bcfnt> <strings.txt> <output.bin>\n", argv[0]);
+		return 1;
+	}
+
+	Bcfnt font;
+	if (!bcfntLoad(&font, argv[1]))
+	{
+		fprintf(stderr, "strtab: can't load font %s\n", argv[1]);
+		return 1;
+	}
+
+	FILE* in = fopen(argv[2], "rb");
+	if (!in)
+	{
+		fprintf(stderr, "strtab: can't open %s\n", argv[2]);
+		return 1;
+	}
+
+	// Each line is one string, with its escapes resolved
+	char* line = NULL;
+	size_t lineCap = 0, len = 0;
+	int c;
+	do
+	{
+		c = fgetc(in);
+		if (c == EOF && len == 0)
+			break;
+		line = (char*)grow(line, &lineCap, len + 1, 1);
+		if (c == '\n' || c == EOF)
+		{
+			if (len && line[len-1] == '\r')
+				len--;
+			line[len] = 0;
+			parseString(&font, (const uint8_t*)line);
+			len = 0;
+		} else if (c == '\\')
+		{
+			c = fgetc(in);
+			line[len++] = c == 'n' ? '\n' : c == EOF ? '\\' : c;
+		} else
+			line[len++] = c;
+	} while (c != EOF);
+	fclose(in);
+	free(line);
+
+	FILE* out = fopen(argv[3], "wb");
+	if (!out)
+	{
+		fprintf(stderr, "strtab: can't create %s\n", argv[3]);
+		return 1;
+	}
+
+	uint8_t header[20];
+	memcpy(header, "C2ST", 4);
+	bcfntWrite16(header + 4, TABLE_VERSION);
+	bcfntWrite16(header + 6, font.nSheets);
+	bcfntWrite16(header + 8, font.nRows*font.nLines);
+	bcfntWrite16(header + 10, font.cellHeight);
+	bcfntWrite32(header + 12, s_numStrings);
+	bcfntWrite32(header + 16, s_numGlyphs);
+	fwrite(header, 1, sizeof(header), out);
+
+	size_t i;
+	for (i = 0; i < s_numStrings; i ++)
+	{
+		uint8_t entry[20];
+		bcfntWrite32(entry + 0, s_strings[i].firstGlyph);
+		bcfntWrite32(entry + 4, s_strings[i].numGlyphs);
+		writeFloat(entry + 8, s_strings[i].width);
+		bcfntWrite32(entry + 12, s_strings[i].lines);
+		bcfntWrite32(entry + 16, s_strings[i].words);
+		fwrite(entry, 1, sizeof(entry), out);
+	}
+
+	for (i = 0; i < s_numGlyphs; i ++)
+	{
+		uint8_t entry[16];
+		writeFloat(entry + 0, s_glyphs[i].xPos);
+		bcfntWrite16(entry + 4, s_glyphs[i].sheet);
+		bcfntWrite16(entry + 6, s_glyphs[i].sheetGlyph);
+		bcfntWrite16(entry + 8, s_glyphs[i].lineNo);
+		bcfntWrite16(entry + 10, s_glyphs[i].wordNo);
+		bcfntWrite16(entry + 12, s_glyphs[i].width);
+		bcfntWrite16(entry + 14, 0);
+		fwrite(entry, 1, sizeof(entry), out);
+	}
+
+	bool ok = !ferror(out);
+	ok = fclose(out) == 0 && ok;
+	bcfntFree(&font);
+	if (!ok)
+	{
+		fprintf(stderr, "strtab: can't write %s\n", argv[3]);
+		return 1;
+	}
+	printf("%zu strings, %zu glyphs\n", s_numStrings, s_numGlyphs);
+	return 0;
+}